@@ -4,6 +4,7 @@
 
 #include "LogLevel.h"
 #include "DebugInfo.h"
+#include "Stats.h"
 #include <stddef.h>
 
 //NOTE: Passing "-fvisibility=hidden" as a compiler option to GCC is advised!
@@ -28,12 +29,39 @@ extern "C" DLL_PUBLIC bool samplog_LogMessage(
 	const char *module, samplog_LogLevel level, const char *msg,
 	samplog_AmxFuncCallInfo const *call_info = NULL,
 	unsigned int call_info_size = 0);
+// returns 0 if the module limit (1024 modules) is reached
+extern "C" DLL_PUBLIC unsigned int samplog_RegisterModule(const char *module);
+extern "C" DLL_PUBLIC bool samplog_LogModuleMessage(
+	unsigned int module_id, samplog_LogLevel level, const char *msg,
+	samplog_AmxFuncCallInfo const *call_info = NULL,
+	unsigned int call_info_size = 0);
+extern "C" DLL_PUBLIC bool samplog_SetModuleLogLevel(const char *module, int levels);
+extern "C" DLL_PUBLIC bool samplog_GetModuleLogLevel(unsigned int module_id, int *levels);
+extern "C" DLL_PUBLIC unsigned int samplog_GetLogLevelGeneration();
+// address of the generation counter (a std::atomic<unsigned int>), it stays
+// valid as long as log-core is loaded
+extern "C" DLL_PUBLIC const void *samplog_GetLogLevelGenerationAddress();
+// keeps a message of a disabled log level in the module's flight recorder,
+// it's only written if an error follows; returns false if there's no recorder
+extern "C" DLL_PUBLIC bool samplog_RecordModuleMessage(
+	unsigned int module_id, samplog_LogLevel level, const char *msg,
+	samplog_AmxFuncCallInfo const *call_info = NULL,
+	unsigned int call_info_size = 0);
+extern "C" DLL_PUBLIC bool samplog_IsFlightRecorderEnabled();
+// 'module_id' 0 gets the stats of all modules together; 'stats->size'
+// has to be set, see samplog/Stats.h
+extern "C" DLL_PUBLIC bool samplog_GetStats(unsigned int module_id, samplog_Stats *stats);
+// waits up to 'timeout_ms' milliseconds until every message logged before
+// the call is written to its log file; 'sync' also waits until the data is
+// on the disk (fdatasync); returns false if the timeout expired
+extern "C" DLL_PUBLIC bool samplog_Flush(unsigned int timeout_ms, bool sync);
 
 
 #ifdef __cplusplus
 
 #include <string>
 #include <vector>
+#include <atomic>
 
 namespace samplog
 {
@@ -52,13 +80,69 @@ namespace samplog
 	{
 		return samplog_LogMessage(module, level, msg, call_info, call_info_size);
 	}
+	inline unsigned int RegisterModule(const char *module)
+	{
+		return samplog_RegisterModule(module);
+	}
+	inline bool LogModuleMessage(
+		unsigned int module_id, LogLevel level, const char *msg,
+		samplog_AmxFuncCallInfo const *call_info = nullptr,
+		unsigned int call_info_size = 0)
+	{
+		return samplog_LogModuleMessage(module_id, level, msg, call_info, call_info_size);
+	}
+	// sets the log levels of 'module' for all plugins, overriding their own
+	// settings; a negative value gives the control back to the plugins
+	inline bool SetModuleLogLevel(const char *module, int levels)
+	{
+		return samplog_SetModuleLogLevel(module, levels);
+	}
+	// returns false if the log levels of the module aren't set by log-core
+	inline bool GetModuleLogLevel(unsigned int module_id, int &levels)
+	{
+		return samplog_GetModuleLogLevel(module_id, &levels);
+	}
+	inline unsigned int GetLogLevelGeneration()
+	{
+		return samplog_GetLogLevelGeneration();
+	}
+	inline std::atomic<unsigned int> const *GetLogLevelGenerationAddress()
+	{
+		return static_cast<std::atomic<unsigned int> const *>(
+			samplog_GetLogLevelGenerationAddress());
+	}
+	inline bool RecordModuleMessage(
+		unsigned int module_id, LogLevel level, const char *msg,
+		samplog_AmxFuncCallInfo const *call_info = nullptr,
+		unsigned int call_info_size = 0)
+	{
+		return samplog_RecordModuleMessage(module_id, level, msg, call_info, call_info_size);
+	}
+	inline bool IsFlightRecorderEnabled()
+	{
+		return samplog_IsFlightRecorderEnabled();
+	}
+	inline bool GetStats(unsigned int module_id, samplog_Stats &stats)
+	{
+		stats.size = sizeof(samplog_Stats);
+		return samplog_GetStats(module_id, &stats);
+	}
+	inline bool Flush(unsigned int timeout_ms, bool sync = false)
+	{
+		return samplog_Flush(timeout_ms, sync);
+	}
 	
 	class CLogger
 	{
 	public:
 		explicit CLogger(std::string modulename) :
 			m_Module(std::move(modulename)),
-			m_LogLevel(static_cast<LogLevel>(LogLevel::ERROR | LogLevel::WARNING))
+			m_ModuleId(samplog::RegisterModule(m_Module.c_str())),
+			m_LogLevel(static_cast<LogLevel>(LogLevel::ERROR | LogLevel::WARNING)),
+			m_LogLevelGeneration(samplog::GetLogLevelGenerationAddress()),
+			m_CoreLogLevelGeneration(0),
+			m_CoreLogLevel(-1),
+			m_FlightRecorder(samplog::IsFlightRecorderEnabled())
 		{ }
 		virtual ~CLogger() = default;
 		CLogger() = delete;
@@ -76,32 +160,80 @@ namespace samplog
 		}
 		inline bool IsLogLevel(LogLevel log_level) const
 		{
-			return (m_LogLevel & log_level) == log_level;
+			return (GetEffectiveLogLevel() & log_level) == log_level;
 		}
 
 		inline bool Log(LogLevel level, const char *msg,
 			std::vector<AmxFuncCallInfo> const &call_info)
 		{
 			if (!IsLogLevel(level))
+			{
+				Record(level, msg, call_info.data(), call_info.size());
 				return false;
+			}
 
-			return samplog::LogMessage(m_Module.c_str(), level, msg, 
+			return samplog::LogModuleMessage(m_ModuleId, level, msg,
 				call_info.data(), call_info.size());
 		}
 
 		inline bool Log(LogLevel level, const char *msg)
 		{
 			if (!IsLogLevel(level))
+			{
+				Record(level, msg);
 				return false;
+			}
 
-			return samplog::LogMessage(m_Module.c_str(), level, msg);
+			return samplog::LogModuleMessage(m_ModuleId, level, msg);
+		}
+
+		// messages of disabled log levels are still worth recording if
+		// log-core's flight recorder is enabled, see samplog_RecordModuleMessage
+		inline bool IsRecording() const
+		{
+			return m_FlightRecorder;
+		}
+
+	protected:
+		inline void Record(LogLevel level, const char *msg,
+			AmxFuncCallInfo const *call_info = nullptr, size_t call_info_size = 0)
+		{
+			if (m_FlightRecorder)
+			{
+				samplog::RecordModuleMessage(m_ModuleId, level, msg,
+					call_info, static_cast<unsigned int>(call_info_size));
+			}
 		}
 
 	protected:
 		std::string m_Module;
+		unsigned int m_ModuleId;
+
+	private:
+		// log levels set in log-core take precedence over our own,
+		// they're only looked up again once they changed
+		inline int GetEffectiveLogLevel() const
+		{
+			const unsigned int generation = m_LogLevelGeneration->load(std::memory_order_acquire);
+			if (generation != m_CoreLogLevelGeneration.load(std::memory_order_acquire))
+			{
+				int levels;
+				if (!samplog::GetModuleLogLevel(m_ModuleId, levels))
+					levels = -1;
+				m_CoreLogLevel.store(levels, std::memory_order_relaxed);
+				m_CoreLogLevelGeneration.store(generation, std::memory_order_release);
+			}
+
+			const int core_levels = m_CoreLogLevel.load(std::memory_order_relaxed);
+			return core_levels >= 0 ? core_levels : m_LogLevel;
+		}
 
 	private:
 		LogLevel m_LogLevel;
+		std::atomic<unsigned int> const * const m_LogLevelGeneration; // owned by log-core
+		mutable std::atomic<unsigned int> m_CoreLogLevelGeneration;
+		mutable std::atomic<int> m_CoreLogLevel;
+		const bool m_FlightRecorder;
 
 	};
 
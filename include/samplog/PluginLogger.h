@@ -5,6 +5,16 @@
 
 #include "Logger.h"
 #include <stdarg.h>
+#include <stdio.h>
+
+// vsprintf_s only exists on MSVC, which in turn has no vsnprintf before
+// Visual Studio 2015; both truncate messages that don't fit
+#if defined(_MSC_VER) && _MSC_VER < 1900
+# define SAMPLOG_VSNPRINTF(buffer, size, format, args) \
+	_vsnprintf_s(buffer, size, _TRUNCATE, format, args)
+#else
+# define SAMPLOG_VSNPRINTF vsnprintf
+#endif
 
 
 //NOTE: Passing "-fvisibility=hidden" as a compiler option to GCC is advised!
@@ -53,7 +63,18 @@ namespace samplog
 		bool Log(AMX * const amx, const LogLevel level, const char *msg)
 		{
 			if (!CLogger::IsLogLevel(level))
+			{
+				// the innermost call is all the flight recorder keeps
+				AmxFuncCallInfo last_call;
+				if (IsRecording())
+				{
+					if (GetLastAmxFunctionCall(amx, last_call))
+						Record(level, msg, &last_call, 1);
+					else
+						Record(level, msg);
+				}
 				return false;
+			}
 
 			std::vector<AmxFuncCallInfo> call_info;
 
@@ -73,7 +94,7 @@ namespace samplog
 			va_list
 				args;
 			va_start(args, format);
-			vsprintf_s(msg, 1024, format, args);
+			SAMPLOG_VSNPRINTF(msg, sizeof(msg), format, args);
 			va_end(args);
 			return Log(level, msg);
 		}
@@ -85,7 +106,7 @@ namespace samplog
 			va_list
 				args;
 			va_start(args, format);
-			vsprintf_s(msg, 1024, format, args);
+			SAMPLOG_VSNPRINTF(msg, sizeof(msg), format, args);
 			va_end(args);
 			return Log(amx, level, msg);
 		}
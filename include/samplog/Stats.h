@@ -0,0 +1,42 @@
+#pragma once
+#ifndef INC_SAMPLOG_STATS_H
+#define INC_SAMPLOG_STATS_H
+
+
+#define SAMPLOG_LATENCY_BUCKETS 32
+
+// new fields are only ever appended; 'size' has to be set to
+// sizeof(samplog_Stats) by the caller, log-core fills in only what fits
+extern "C" typedef struct
+{
+	unsigned int size;
+	unsigned long long messages_written;
+	unsigned long long bytes_written;
+	unsigned long long flushes;
+	unsigned long long dropped_messages;
+	// messages waiting for the writer thread (current and highest value)
+	unsigned long long queue_depth;
+	unsigned long long queue_high_water;
+	// time from logging a message until the writer thread put it into the
+	// log file's buffer, not until it's on the disk (see logcore_flushsize):
+	// buffer_latency_histogram[0] counts messages buffered within 1 microsecond,
+	// buffer_latency_histogram[i] those which took from 2^(i-1) up to 2^i
+	// microseconds; flight recorder messages aren't counted
+	unsigned long long buffer_latency_histogram[SAMPLOG_LATENCY_BUCKETS];
+	// repeated messages collapsed into a "last message repeated" line
+	unsigned long long duplicate_messages;
+	// messages over the rate limit, counted instead of written
+	unsigned long long rate_limited_messages;
+	// the module's rate limit in messages per second and the messages it may
+	// currently log at once (0 if the module has no limit or for module_id 0)
+	unsigned long long rate_limit;
+	unsigned long long rate_limit_tokens;
+	// messages the writer threads took from their queues at once: number of
+	// batches, messages in them and the largest batch (only for module_id 0)
+	unsigned long long batches;
+	unsigned long long batched_messages;
+	unsigned long long max_batch_size;
+} samplog_Stats;
+
+
+#endif /* INC_SAMPLOG_STATS_H */
@@ -97,24 +97,44 @@ bool CAmxDebugManager::InitDebugData(string filepath)
 
 void CAmxDebugManager::RegisterAmx(AMX *amx)
 {
-	if (m_DisableDebugInfo)
-		return;
-
-	if (m_AmxDebugMap.find(amx) != m_AmxDebugMap.end()) //amx already registered
-		return;
-
-	for (auto &d : m_AvailableDebugInfo)
+	AMX_DBG *amx_dbg = nullptr;
+	if (!m_DisableDebugInfo && m_AmxDebugMap.find(amx) == m_AmxDebugMap.end())
 	{
-		if (memcmp(d.first, amx->base, sizeof(AMX_HEADER)) == 0)
+		for (auto &d : m_AvailableDebugInfo)
 		{
-			m_AmxDebugMap.emplace(amx, d.second);
-			break;
+			if (memcmp(d.first, amx->base, sizeof(AMX_HEADER)) == 0)
+			{
+				amx_dbg = d.second;
+				m_AmxDebugMap.emplace(amx, amx_dbg);
+				break;
+			}
 		}
 	}
+
+	RegisteredAmx *free_entry = nullptr;
+	for (auto &r : m_RegisteredAmx)
+	{
+		AMX *registered = r.amx.load(std::memory_order_relaxed);
+		if (registered == amx) //amx already registered
+			return;
+		if (registered == nullptr && free_entry == nullptr)
+			free_entry = &r;
+	}
+	if (free_entry != nullptr)
+	{
+		free_entry->debug_info.store(amx_dbg, std::memory_order_relaxed);
+		free_entry->amx.store(amx, std::memory_order_release);
+	}
 }
 
 void CAmxDebugManager::EraseAmx(AMX *amx)
 {
+	for (auto &r : m_RegisteredAmx)
+	{
+		if (r.amx.load(std::memory_order_relaxed) == amx)
+			r.amx.store(nullptr, std::memory_order_release);
+	}
+
 	if (m_DisableDebugInfo)
 		return;
 
@@ -123,73 +143,129 @@ void CAmxDebugManager::EraseAmx(AMX *amx)
 
 bool CAmxDebugManager::GetFunctionCall(AMX * const amx, ucell address, AmxFuncCallInfo &dest)
 {
-	if (m_DisableDebugInfo)
-		return false;
-
-	auto it = m_AmxDebugMap.find(amx);
-	if (it == m_AmxDebugMap.end())
+	AMX_DBG *amx_dbg = GetDebugInfo(amx);
+	if (amx_dbg == nullptr)
 		return false;
 
-	AMX_DBG *amx_dbg = it->second;
-
-	if (dbg_LookupLine(amx_dbg, address, &(dest.line)) != AMX_ERR_NONE)
-		return false;
+	return LookupAddress(amx_dbg, address, dest);
+}
 
-	if (dbg_LookupFile(amx_dbg, address, &(dest.file)) != AMX_ERR_NONE)
-		return false;
+size_t CAmxDebugManager::GetFunctionCallTrace(AMX * const amx,
+	AmxFuncCallInfo *dest, size_t max_size)
+{
+	AMX_DBG *amx_dbg = GetDebugInfo(amx);
+	if (amx_dbg == nullptr || max_size == 0)
+		return 0;
 
-	if (dbg_LookupFunction(amx_dbg, address, &(dest.function)) != AMX_ERR_NONE)
-		return false;
+	ucell stack_addresses[64];
+	std::vector<ucell> heap_addresses;
+	ucell *addresses = stack_addresses;
+	if (max_size > sizeof(stack_addresses) / sizeof(stack_addresses[0]))
+	{
+		heap_addresses.resize(max_size);
+		addresses = heap_addresses.data();
+	}
 
-	dest.line++; // HACK: not sure if this is correct
-	return true;
+	bool complete;
+	const size_t count = GetCallStackAddresses(amx, addresses, max_size, complete);
+	return ResolveCallStack(amx_dbg, addresses, count, complete, dest);
 }
 
-bool CAmxDebugManager::GetFunctionCallTrace(AMX * const amx, std::vector<AmxFuncCallInfo> &dest)
+AMX_DBG *CAmxDebugManager::GetDebugInfo(AMX * const amx)
 {
 	if (m_DisableDebugInfo)
-		return false;
+		return nullptr;
 
 	auto it = m_AmxDebugMap.find(amx);
 	if (it == m_AmxDebugMap.end())
-		return false;
+		return nullptr;
 
-	AMX_DBG *amx_dbg = it->second;
-	AmxFuncCallInfo call_info;
+	return it->second;
+}
 
-	if (!GetFunctionCall(amx, amx->cip, call_info))
-		return false;
+size_t CAmxDebugManager::GetCallStackAddresses(AMX * const amx,
+	ucell *dest, size_t max_size, bool &complete)
+{
+	complete = false;
+	if (max_size == 0)
+		return 0;
 
-	dest.push_back(call_info);
+	size_t count = 0;
+	dest[count++] = amx->cip;
 
 	AMX_HEADER *base = reinterpret_cast<AMX_HEADER *>(amx->base);
 	cell dat = reinterpret_cast<cell>(amx->base + base->dat);
-	cell cod = reinterpret_cast<cell>(amx->base + base->cod);
 
 	cell frm_addr = amx->frm;
 
 	while (true)
 	{
+		// a frame holds the previous frame address and the return address,
+		// anything outside of the stack means the AMX is corrupted
+		if (frm_addr < amx->hea || frm_addr > amx->stp - static_cast<cell>(2 * sizeof(cell)))
+			break;
+
 		cell ret_addr = *(reinterpret_cast<cell *>(dat + frm_addr + sizeof(cell)));
 
 		if (ret_addr == 0)
+		{
+			complete = true;
+			break;
+		}
+
+		// truncated, there are older calls left
+		if (count == max_size)
 			break;
 
-		if (GetFunctionCall(amx, ret_addr, call_info))
-			dest.push_back(call_info);
-		else
-			dest.push_back({ 0, "<unknown>", "<unknown>" });
+		dest[count++] = ret_addr;
 
 		frm_addr = *(reinterpret_cast<cell *>(dat + frm_addr));
 		if (frm_addr == 0)
+		{
+			complete = true;
 			break;
+		}
+	}
+
+	return count;
+}
+
+size_t CAmxDebugManager::ResolveCallStack(AMX_DBG *amx_dbg,
+	ucell const *addresses, size_t count, bool complete, AmxFuncCallInfo *dest)
+{
+	if (amx_dbg == nullptr || count == 0)
+		return 0;
+
+	if (!LookupAddress(amx_dbg, addresses[0], dest[0]))
+		return 0;
+
+	for (size_t i = 1; i != count; ++i)
+	{
+		if (!LookupAddress(amx_dbg, addresses[i], dest[i]))
+			dest[i] = { 0, "<unknown>", "<unknown>" };
 	}
 
 	//HACK: for some reason the oldest/highest call (not cip though) 
 	//      has a slightly incorrect ret_addr
-	if (dest.size() > 1)
-		dest.back().line--;
+	//      (only if the trace wasn't cut off, otherwise that call isn't in it)
+	if (complete && count > 1)
+		dest[count - 1].line--;
+
+	return count;
+}
+
+bool CAmxDebugManager::LookupAddress(AMX_DBG *amx_dbg, ucell address, AmxFuncCallInfo &dest)
+{
+	if (dbg_LookupLine(amx_dbg, address, &(dest.line)) != AMX_ERR_NONE)
+		return false;
+
+	if (dbg_LookupFile(amx_dbg, address, &(dest.file)) != AMX_ERR_NONE)
+		return false;
+
+	if (dbg_LookupFunction(amx_dbg, address, &(dest.function)) != AMX_ERR_NONE)
+		return false;
 
+	dest.line++; // HACK: not sure if this is correct
 	return true;
 }
 
@@ -217,13 +293,5 @@ unsigned int samplog_GetAmxFunctionCallTrace(AMX * const amx, samplog_AmxFuncCal
 	if (destination == nullptr || max_size == 0)
 		return 0;
 
-	std::vector<AmxFuncCallInfo> calls;
-	if (!CAmxDebugManager::Get()->GetFunctionCallTrace(amx, calls))
-		return 0;
-	
-	size_t size = std::min(calls.size(), max_size);
-	for (size_t i = 0; i < size; ++i)
-		destination[i] = calls.at(i);
-
-	return size;
+	return CAmxDebugManager::Get()->GetFunctionCallTrace(amx, destination, max_size);
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <atomic>
 #include <memory>
 #include <unordered_map>
 #include <vector>
@@ -39,12 +40,43 @@ public:
 	void EraseAmx(AMX *amx);
 
 	bool GetFunctionCall(AMX * const amx, ucell address, AmxFuncCallInfo &dest);
-	bool GetFunctionCallTrace(AMX * const amx, std::vector<AmxFuncCallInfo> &dest);
+	// returns the number of entries written to 'dest', '0' on failure
+	size_t GetFunctionCallTrace(AMX * const amx, AmxFuncCallInfo *dest, size_t max_size);
+
+	// the debug info of 'amx' or nullptr; stays valid as long as this manager exists
+	AMX_DBG *GetDebugInfo(AMX * const amx);
+	// collects the current instruction pointer and all return addresses
+	// without resolving them, returns the number of addresses written to 'dest';
+	// 'complete' is false if the call stack didn't fit or is corrupted
+	size_t GetCallStackAddresses(AMX * const amx, ucell *dest, size_t max_size,
+		bool &complete);
+	// resolves addresses collected by GetCallStackAddresses, can be used from any thread;
+	// returns the number of entries written to 'dest', '0' on failure
+	static size_t ResolveCallStack(AMX_DBG *amx_dbg, ucell const *addresses, size_t count,
+		bool complete, AmxFuncCallInfo *dest);
+
+	// all registered AMX instances, also those without debug info; kept in
+	// a fixed table so the crash handler can go through them without
+	// allocating or locking
+	static const size_t MaxRegisteredAmx = 64;
+	struct RegisteredAmx
+	{
+		std::atomic<AMX *> amx{ nullptr };
+		std::atomic<AMX_DBG *> debug_info{ nullptr };
+	};
+	inline RegisteredAmx const *GetRegisteredAmx() const
+	{
+		return m_RegisteredAmx;
+	}
+
+private:
+	static bool LookupAddress(AMX_DBG *amx_dbg, ucell address, AmxFuncCallInfo &dest);
 
 private:
 	bool m_DisableDebugInfo = false;
 	unordered_map<AMX_HEADER *, AMX_DBG *> m_AvailableDebugInfo;
 	unordered_map<AMX *, AMX_DBG *> m_AmxDebugMap;
+	RegisteredAmx m_RegisteredAmx[MaxRegisteredAmx];
 };
 
 extern "C" DLL_PUBLIC void samplog_RegisterAmx(AMX *amx);
@@ -0,0 +1,75 @@
+#include "CDuplicateFilter.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+
+// std::min takes it by reference
+const size_t CDuplicateFilter::MaxTextLength;
+
+
+namespace
+{
+	// FNV-1a
+	const uint64_t HashOffset = 14695981039346656037ull;
+
+	uint64_t HashBytes(uint64_t hash, const void *data, size_t length)
+	{
+		const unsigned char *bytes = static_cast<const unsigned char *>(data);
+		for (size_t i = 0; i != length; ++i)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	// only the innermost call counts, the rest of the call stack doesn't
+	// make a message any different
+	AmxFuncCallInfo GetCallSite(CMessage const &msg)
+	{
+		if (msg.GetCallInfoCount() == 0)
+			return { 0, nullptr, nullptr };
+		return msg.GetCallInfo()[0];
+	}
+}
+
+
+uint64_t CDuplicateFilter::Hash(CMessage const &msg)
+{
+	const AmxFuncCallInfo call_site = GetCallSite(msg);
+	uint64_t hash = HashOffset;
+	hash = HashBytes(hash, &msg.log_module, sizeof(msg.log_module));
+	hash = HashBytes(hash, &msg.loglevel, sizeof(msg.loglevel));
+	hash = HashBytes(hash, &call_site.line, sizeof(call_site.line));
+	// the file names come from the AMX debug info and are never copied
+	hash = HashBytes(hash, &call_site.file, sizeof(call_site.file));
+	return HashBytes(hash, msg.GetText(), msg.GetTextLength());
+}
+
+bool CDuplicateFilter::IsSame(Entry const &entry, uint64_t hash, CMessage const &msg)
+{
+	if (entry.hash != hash || entry.module != msg.log_module
+		|| entry.level != msg.loglevel || entry.text_length != msg.GetTextLength())
+	{
+		return false;
+	}
+
+	const AmxFuncCallInfo call_site = GetCallSite(msg);
+	return entry.call_site.line == call_site.line
+		&& entry.call_site.file == call_site.file
+		&& std::memcmp(entry.text, msg.GetText(),
+			std::min(entry.text_length, MaxTextLength)) == 0;
+}
+
+void CDuplicateFilter::Assign(Entry &entry, uint64_t hash, CMessage const &msg)
+{
+	entry.hash = hash;
+	entry.module = msg.log_module;
+	entry.level = msg.loglevel;
+	entry.call_site = GetCallSite(msg);
+	entry.text_length = msg.GetTextLength();
+	std::memcpy(entry.text, msg.GetText(), std::min(entry.text_length, MaxTextLength));
+	entry.window_start = entry.last_seen = msg.timestamp;
+	entry.repeats = 0;
+}
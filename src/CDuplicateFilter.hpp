@@ -0,0 +1,117 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "CMessage.hpp"
+
+
+// collapses repeated messages (same module, log level, text and call site)
+// within a time window: the first one gets written, the others are only
+// counted; only used by a single writer thread
+class CDuplicateFilter
+{
+public:
+	using Clock = std::chrono::system_clock;
+
+	static const size_t MaxTextLength = 128; // kept for the summary line
+
+	struct Entry
+	{
+		uint64_t hash = 0;
+		ModuleId module = InvalidModuleId; // InvalidModuleId if the entry is unused
+		LogLevel level = LogLevel::NONE;
+		AmxFuncCallInfo call_site = { 0, nullptr, nullptr };
+		size_t text_length = 0;
+		char text[MaxTextLength];
+
+		Clock::time_point window_start;
+		Clock::time_point last_seen;
+		unsigned int repeats = 0; // since the window started
+	};
+
+	// 'window' 0 disables the filter
+	explicit CDuplicateFilter(std::chrono::milliseconds window) :
+		m_Window(window)
+	{ }
+	~CDuplicateFilter() = default;
+	CDuplicateFilter(const CDuplicateFilter &rhs) = delete;
+	CDuplicateFilter &operator=(const CDuplicateFilter &rhs) = delete;
+
+public:
+	inline bool IsEnabled() const
+	{
+		return m_Window.count() != 0;
+	}
+
+	// returns false if 'msg' repeats a recent message and shouldn't be
+	// written; 'report' is called first with the entry of every message
+	// whose repeats are due to be reported
+	template<typename F>
+	bool Check(CMessage const &msg, F report)
+	{
+		const uint64_t hash = Hash(msg);
+		Entry &entry = m_Entries[hash % EntryCount];
+		if (entry.module != InvalidModuleId && IsSame(entry, hash, msg))
+		{
+			if (msg.timestamp - entry.window_start < m_Window)
+			{
+				++entry.repeats;
+				entry.last_seen = msg.timestamp;
+				return false;
+			}
+
+			// still repeating after a whole window, report and start over
+			if (entry.repeats != 0)
+				report(entry);
+			entry.window_start = entry.last_seen = msg.timestamp;
+			entry.repeats = 0;
+			return true;
+		}
+
+		// evict whatever was there before
+		if (entry.module != InvalidModuleId && entry.repeats != 0)
+			report(entry);
+		Assign(entry, hash, msg);
+		return true;
+	}
+
+	// reports and forgets all messages which weren't repeated for a whole window
+	template<typename F>
+	void Expire(Clock::time_point now, F report)
+	{
+		for (auto &e : m_Entries)
+		{
+			if (e.module == InvalidModuleId || now - e.last_seen < m_Window)
+				continue;
+
+			if (e.repeats != 0)
+				report(e);
+			e.module = InvalidModuleId;
+		}
+	}
+
+	// reports all pending repeats, e.g. on shutdown
+	template<typename F>
+	void ExpireAll(F report)
+	{
+		for (auto &e : m_Entries)
+		{
+			if (e.module != InvalidModuleId && e.repeats != 0)
+				report(e);
+			e.module = InvalidModuleId;
+		}
+	}
+
+private:
+	static uint64_t Hash(CMessage const &msg);
+	static bool IsSame(Entry const &entry, uint64_t hash, CMessage const &msg);
+	static void Assign(Entry &entry, uint64_t hash, CMessage const &msg);
+
+private:
+	static const size_t EntryCount = 256;
+
+	const std::chrono::milliseconds m_Window;
+	Entry m_Entries[EntryCount];
+};
@@ -0,0 +1,73 @@
+#include "CFlightRecorder.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+
+static_assert(std::is_trivially_copyable<CFlightRecorder::Record>::value,
+	"records are copied as raw words");
+
+// std::min takes it by reference
+const size_t CFlightRecorder::MaxTextLength;
+
+
+CFlightRecorder::CFlightRecorder(size_t capacity) :
+	m_Capacity(std::max<size_t>(capacity, 1)),
+	m_Slots(new Slot[m_Capacity])
+{ }
+
+void CFlightRecorder::Add(LogLevel level, const char *text, size_t text_length,
+	AmxFuncCallInfo const *call_info, size_t call_info_count)
+{
+	const uint64_t index = m_Next.fetch_add(1, std::memory_order_relaxed);
+	Slot &slot = m_Slots[index % m_Capacity];
+
+	// index '0' has to be told apart from a slot which was never written;
+	// the slot can only be claimed if it holds a finished older record
+	const uint64_t claimed = index * 2 + 1;
+	uint64_t sequence = slot.sequence.load(std::memory_order_relaxed);
+	do
+	{
+		if ((sequence % 2) != 0 || sequence >= claimed)
+			return;
+	} while (!slot.sequence.compare_exchange_weak(sequence, claimed,
+		std::memory_order_relaxed));
+	std::atomic_thread_fence(std::memory_order_release);
+
+	Record record;
+	record.timestamp = std::chrono::system_clock::now();
+	record.level = level;
+	if (call_info != nullptr && call_info_count != 0)
+		record.call_info = call_info[0];
+	else
+		record.call_info = { 0, nullptr, nullptr };
+	record.text_length = std::min(text_length, MaxTextLength);
+	std::memcpy(record.text, text, record.text_length);
+
+	uint64_t words[RecordWords] = { };
+	std::memcpy(words, &record, sizeof(Record));
+	for (size_t i = 0; i != RecordWords; ++i)
+		slot.data[i].store(words[i], std::memory_order_relaxed);
+
+	slot.sequence.store(index * 2 + 2, std::memory_order_release);
+}
+
+bool CFlightRecorder::Read(uint64_t index, Record &dest) const
+{
+	Slot const &slot = m_Slots[index % m_Capacity];
+	const uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+	if (sequence != index * 2 + 2)
+		return false;
+
+	uint64_t words[RecordWords];
+	for (size_t i = 0; i != RecordWords; ++i)
+		words[i] = slot.data[i].load(std::memory_order_relaxed);
+
+	std::atomic_thread_fence(std::memory_order_acquire);
+	if (slot.sequence.load(std::memory_order_relaxed) != sequence)
+		return false;
+
+	std::memcpy(&dest, words, sizeof(Record));
+	return true;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "CAmxDebugManager.hpp"
+#include "loglevel.hpp"
+
+
+/*
+  Keeps the last messages of a module which weren't logged because their
+  log level is disabled, so they can be written as context once an error
+  happens. Records have a fixed size and are overwritten in a circle;
+  every slot carries a sequence number which is odd while the slot is
+  written, so readers can tell torn records apart without locking. A
+  writer which finds its slot still busy with (or already taken by)
+  another lap drops its record instead of writing over it.
+  Adding is lock-free and safe from any thread, taking records out is only
+  done by the module's writer thread (or the crash handler) and neither
+  allocates nor locks either.
+*/
+class CFlightRecorder
+{
+public:
+	static const size_t MaxTextLength = 200; // longer texts get truncated
+
+	struct Record
+	{
+		std::chrono::system_clock::time_point timestamp;
+		LogLevel level;
+		AmxFuncCallInfo call_info; // innermost call only, 'file' is nullptr if unknown
+		size_t text_length;
+		char text[MaxTextLength];
+	};
+
+	explicit CFlightRecorder(size_t capacity);
+	~CFlightRecorder() = default;
+	CFlightRecorder(const CFlightRecorder &rhs) = delete;
+	CFlightRecorder &operator=(const CFlightRecorder &rhs) = delete;
+
+public:
+	void Add(LogLevel level, const char *text, size_t text_length,
+		AmxFuncCallInfo const *call_info, size_t call_info_count);
+
+	// calls 'func' with every record added at or before 'until' which wasn't
+	// taken yet, oldest first; records which got overwritten meanwhile are skipped
+	template<typename F>
+	void TakeUntil(std::chrono::system_clock::time_point until, F func)
+	{
+		const uint64_t next = m_Next.load(std::memory_order_acquire);
+		if (next - m_Taken > m_Capacity)
+			m_Taken = next - m_Capacity;
+
+		Record record;
+		for (; m_Taken != next; ++m_Taken)
+		{
+			if (!Read(m_Taken, record))
+				continue;
+			if (record.timestamp > until)
+				break;
+			func(record);
+		}
+	}
+
+private:
+	// returns false if the record is being written or got overwritten
+	bool Read(uint64_t index, Record &dest) const;
+
+private:
+	// the record is copied in words of relaxed atomics, so a reader racing
+	// with a writer gets a torn copy (which it throws away) and not UB
+	static const size_t RecordWords = (sizeof(Record) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+	struct Slot
+	{
+		std::atomic<uint64_t> sequence{ 0 };
+		std::atomic<uint64_t> data[RecordWords];
+	};
+
+	const size_t m_Capacity;
+	std::unique_ptr<Slot[]> m_Slots;
+	std::atomic<uint64_t> m_Next{ 0 };
+	uint64_t m_Taken = 0; // only used by the reader
+};
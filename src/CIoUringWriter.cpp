@@ -0,0 +1,245 @@
+#include "CIoUringWriter.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+
+namespace
+{
+	int io_uring_setup(unsigned int entries, io_uring_params *params)
+	{
+		return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+	}
+
+	int io_uring_enter(int fd, unsigned int to_submit,
+		unsigned int min_complete, unsigned int flags)
+	{
+		return static_cast<int>(syscall(__NR_io_uring_enter,
+			fd, to_submit, min_complete, flags, nullptr, 0));
+	}
+}
+
+
+std::unique_ptr<CIoUringWriter> CIoUringWriter::Create(unsigned int queue_depth)
+{
+	io_uring_params params;
+	memset(&params, 0, sizeof(params));
+
+	std::unique_ptr<CIoUringWriter> writer(new CIoUringWriter);
+	writer->m_RingFd = io_uring_setup(queue_depth, &params);
+	if (writer->m_RingFd < 0)
+		return nullptr;
+
+	// we rely on writes at the current file position (Linux 5.6+)
+	if ((params.features & IORING_FEAT_RW_CUR_POS) == 0)
+		return nullptr;
+
+	writer->m_SqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+	writer->m_CqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	writer->m_SqesSize = params.sq_entries * sizeof(io_uring_sqe);
+
+	writer->m_SqRing = mmap(nullptr, writer->m_SqRingSize, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, writer->m_RingFd, IORING_OFF_SQ_RING);
+	if (writer->m_SqRing == MAP_FAILED)
+	{
+		writer->m_SqRing = nullptr;
+		return nullptr;
+	}
+
+	writer->m_CqRing = mmap(nullptr, writer->m_CqRingSize, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, writer->m_RingFd, IORING_OFF_CQ_RING);
+	if (writer->m_CqRing == MAP_FAILED)
+	{
+		writer->m_CqRing = nullptr;
+		return nullptr;
+	}
+
+	void *sqes = mmap(nullptr, writer->m_SqesSize, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, writer->m_RingFd, IORING_OFF_SQES);
+	if (sqes == MAP_FAILED)
+		return nullptr;
+	writer->m_Sqes = static_cast<io_uring_sqe *>(sqes);
+
+	unsigned char *sq = static_cast<unsigned char *>(writer->m_SqRing);
+	writer->m_SqHead = reinterpret_cast<unsigned int *>(sq + params.sq_off.head);
+	writer->m_SqTail = reinterpret_cast<unsigned int *>(sq + params.sq_off.tail);
+	writer->m_SqMask = reinterpret_cast<unsigned int *>(sq + params.sq_off.ring_mask);
+	writer->m_SqArray = reinterpret_cast<unsigned int *>(sq + params.sq_off.array);
+
+	unsigned char *cq = static_cast<unsigned char *>(writer->m_CqRing);
+	writer->m_CqHead = reinterpret_cast<unsigned int *>(cq + params.cq_off.head);
+	writer->m_CqTail = reinterpret_cast<unsigned int *>(cq + params.cq_off.tail);
+	writer->m_CqMask = reinterpret_cast<unsigned int *>(cq + params.cq_off.ring_mask);
+	writer->m_Cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+
+	return writer;
+}
+
+CIoUringWriter::~CIoUringWriter()
+{
+	if (m_Sqes != nullptr)
+		munmap(m_Sqes, m_SqesSize);
+	if (m_CqRing != nullptr)
+		munmap(m_CqRing, m_CqRingSize);
+	if (m_SqRing != nullptr)
+		munmap(m_SqRing, m_SqRingSize);
+	if (m_RingFd >= 0)
+		close(m_RingFd);
+}
+
+void CIoUringWriter::Write(CLogFile &file)
+{
+	if (file.m_WriteInProgress)
+	{
+		file.m_WriteRequested = true;
+		return;
+	}
+
+	file.m_WriteBuffer.swap(file.m_Buffer);
+	file.m_WriteOffset = 0;
+	file.m_WriteInProgress = true;
+	file.m_WriteRequested = false;
+	QueueWrite(file);
+}
+
+void CIoUringWriter::Submit()
+{
+	if (Enter(0))
+		Reap();
+}
+
+void CIoUringWriter::Wait(CLogFile &file)
+{
+	while (file.m_WriteInProgress)
+	{
+		if (!Enter(1))
+		{
+			// completions can't be waited for anymore; if the kernel still
+			// completes the write, the data ends up twice in the file
+			WriteDirectly(file);
+			return;
+		}
+		Reap();
+	}
+}
+
+io_uring_sqe *CIoUringWriter::GetSqe()
+{
+	while (true)
+	{
+		if (m_Failed)
+			return nullptr;
+
+		const unsigned int
+			head = __atomic_load_n(m_SqHead, __ATOMIC_ACQUIRE),
+			tail = *m_SqTail;
+		if (tail - head <= *m_SqMask)
+		{
+			const unsigned int index = tail & *m_SqMask;
+			m_SqArray[index] = index;
+			return &m_Sqes[index];
+		}
+
+		// submission queue is full, make some room
+		if (!Enter(1))
+			return nullptr;
+		Reap();
+	}
+}
+
+bool CIoUringWriter::Enter(unsigned int min_complete)
+{
+	if (m_Failed)
+		return false;
+	if (m_Unsubmitted == 0 && min_complete == 0)
+		return true;
+
+	int ret;
+	do
+	{
+		ret = io_uring_enter(m_RingFd, m_Unsubmitted, min_complete,
+			min_complete != 0 ? IORING_ENTER_GETEVENTS : 0);
+	} while (ret < 0 && errno == EINTR);
+
+	if (ret < 0)
+	{
+		// the ring can't be used anymore, everything left (and everything
+		// after this) is written the blocking way; completions aren't
+		// reaped anymore either, their files might be gone already
+		m_Failed = true;
+		return false;
+	}
+
+	m_Unsubmitted -= static_cast<unsigned int>(ret);
+	return true;
+}
+
+void CIoUringWriter::QueueWrite(CLogFile &file)
+{
+	io_uring_sqe *sqe = GetSqe();
+	if (sqe == nullptr)
+	{
+		WriteDirectly(file);
+		return;
+	}
+
+	memset(sqe, 0, sizeof(io_uring_sqe));
+	sqe->opcode = IORING_OP_WRITE;
+	sqe->fd = fileno(file.m_File);
+	sqe->off = static_cast<decltype(sqe->off)>(-1); // current file position
+	sqe->addr = reinterpret_cast<uintptr_t>(file.m_WriteBuffer.data() + file.m_WriteOffset);
+	sqe->len = static_cast<unsigned int>(file.m_WriteBuffer.length() - file.m_WriteOffset);
+	sqe->user_data = reinterpret_cast<uintptr_t>(&file);
+
+	// make the entry visible to the kernel
+	__atomic_store_n(m_SqTail, *m_SqTail + 1, __ATOMIC_RELEASE);
+	++m_Unsubmitted;
+}
+
+void CIoUringWriter::WriteDirectly(CLogFile &file)
+{
+	std::fwrite(file.m_WriteBuffer.data() + file.m_WriteOffset, 1,
+		file.m_WriteBuffer.length() - file.m_WriteOffset, file.m_File);
+	file.m_WriteBuffer.clear();
+	file.m_WriteInProgress = false;
+}
+
+void CIoUringWriter::Reap()
+{
+	// the head is read again for every entry: queueing a write below
+	// can reap completions itself if the submission queue is full
+	while (true)
+	{
+		const unsigned int head = *m_CqHead;
+		if (head == __atomic_load_n(m_CqTail, __ATOMIC_ACQUIRE))
+			break;
+
+		io_uring_cqe const &cqe = m_Cqes[head & *m_CqMask];
+		CLogFile &file = *reinterpret_cast<CLogFile *>(static_cast<uintptr_t>(cqe.user_data));
+		const int result = cqe.res;
+		__atomic_store_n(m_CqHead, head + 1, __ATOMIC_RELEASE);
+
+		if (result > 0)
+			file.m_WriteOffset += static_cast<size_t>(result);
+
+		if (result == -EINTR || result == -EAGAIN
+			|| (result > 0 && file.m_WriteOffset < file.m_WriteBuffer.length()))
+		{
+			// short write, write the rest
+			QueueWrite(file);
+			continue;
+		}
+
+		// on error the data is lost, just like with a failing fwrite
+		file.m_WriteBuffer.clear();
+		file.m_WriteInProgress = false;
+
+		if (file.m_WriteRequested && !file.m_Buffer.empty())
+			Write(file);
+	}
+}
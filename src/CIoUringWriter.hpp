@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+
+#include "CLogFile.hpp"
+
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+// asynchronous log file writer based on Linux' io_uring; flushed file buffers
+// are queued up and submitted with a single syscall, completions are reaped
+// while the writer thread already formats the next batch; if the ring fails,
+// the remaining writes fall back to blocking fwrite calls
+class CIoUringWriter
+{
+public:
+	// returns nullptr if io_uring isn't available on this system
+	static std::unique_ptr<CIoUringWriter> Create(unsigned int queue_depth);
+	~CIoUringWriter();
+	CIoUringWriter(const CIoUringWriter &rhs) = delete;
+	CIoUringWriter &operator=(const CIoUringWriter &rhs) = delete;
+
+private:
+	CIoUringWriter() = default;
+
+public:
+	// queues the buffered data of 'file'; if a write for this file is already
+	// in progress, the data is written once that one completes
+	void Write(CLogFile &file);
+	// submits all queued writes and reaps completed ones without waiting
+	void Submit();
+	// waits until no write for 'file' is in progress anymore
+	void Wait(CLogFile &file);
+
+private:
+	// returns nullptr if the ring failed
+	io_uring_sqe *GetSqe();
+	// returns false if the ring failed
+	bool Enter(unsigned int min_complete);
+	void Reap();
+	void QueueWrite(CLogFile &file);
+	// writes the rest of the file's write buffer with a blocking write
+	void WriteDirectly(CLogFile &file);
+
+private:
+	int m_RingFd = -1;
+
+	void *m_SqRing = nullptr;
+	size_t m_SqRingSize = 0;
+	void *m_CqRing = nullptr;
+	size_t m_CqRingSize = 0;
+	io_uring_sqe *m_Sqes = nullptr;
+	size_t m_SqesSize = 0;
+
+	unsigned int
+		*m_SqHead = nullptr,
+		*m_SqTail = nullptr,
+		*m_SqMask = nullptr,
+		*m_SqArray = nullptr,
+		*m_CqHead = nullptr,
+		*m_CqTail = nullptr,
+		*m_CqMask = nullptr;
+	io_uring_cqe *m_Cqes = nullptr;
+
+	unsigned int m_Unsubmitted = 0;
+	bool m_Failed = false;
+};
@@ -0,0 +1,249 @@
+#include "CLogFile.hpp"
+
+#ifdef LOGCORE_IO_URING
+#  include "CIoUringWriter.hpp"
+#endif
+#ifdef LOGCORE_MMAP
+#  include "CMappedFile.hpp"
+#endif
+
+#include <sys/stat.h>
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__)
+#  include <io.h>
+#else
+#  include <unistd.h>
+#endif
+
+
+CLogFile::CLogFile(string filepath, bool append, size_t buffer_size /*= 0*/,
+	CIoUringWriter *async_writer /*= nullptr*/, size_t mapped_segment_size /*= 0*/) :
+	m_Path(std::move(filepath)),
+	m_LastWriteTime(Clock::now()),
+	m_BufferSize(buffer_size),
+	m_AsyncWriter(async_writer)
+{
+	// the last modification is the best guess we have for existing files
+	struct stat st;
+	if (append && stat(m_Path.c_str(), &st) == 0 && st.st_size > 0)
+		m_StartTime = st.st_mtime;
+	else
+		m_StartTime = std::time(nullptr);
+
+#ifdef LOGCORE_MMAP
+	if (mapped_segment_size != 0)
+	{
+		m_MappedFile = CMappedFile::Open(m_Path, append, mapped_segment_size);
+		if (m_MappedFile)
+		{
+			m_IsNew = m_MappedFile->GetSize() == 0;
+			return;
+		}
+		// fall back to regular writes
+	}
+#endif
+
+	OpenFile(append);
+}
+
+void CLogFile::OpenFile(bool append)
+{
+	m_File = std::fopen(m_Path.c_str(), append ? "ab" : "wb");
+	if (m_File == nullptr)
+		return;
+
+	// we do the buffering ourselves
+	std::setvbuf(m_File, nullptr, _IONBF, 0);
+
+	if (append)
+	{
+		std::fseek(m_File, 0, SEEK_END);
+		const long size = std::ftell(m_File);
+		m_Size = size > 0 ? static_cast<size_t>(size) : 0;
+		m_IsNew = m_Size == 0;
+	}
+	m_Buffer.reserve(m_BufferSize);
+}
+
+CLogFile::~CLogFile()
+{
+	if (m_File == nullptr)
+		return;
+
+	// the last write has to be submitted and finished before closing
+	Sync(false);
+	std::fclose(m_File);
+}
+
+void CLogFile::Write(const char *data, size_t length)
+{
+#ifdef LOGCORE_MMAP
+	if (m_MappedFile)
+	{
+		// the data is in the page cache right away, nothing to buffer
+		const size_t size = m_MappedFile->GetSize();
+		if (m_MappedFile->Write(data, length))
+		{
+			m_LastWriteTime = Clock::now();
+			return;
+		}
+
+		// the disk is full or the file was truncated, write the rest of the
+		// data and everything after it without the mapping
+		const size_t written = m_MappedFile->GetSize() - size;
+		data += written;
+		length -= written;
+		m_MappedFile.reset();
+		OpenFile(true);
+	}
+#endif
+
+	if (m_File == nullptr)
+		return;
+
+	m_Buffer.append(data, length);
+	m_Size += length;
+	m_LastWriteTime = Clock::now();
+
+	if (m_Buffer.length() >= m_BufferSize)
+		Flush();
+}
+
+size_t CLogFile::GetSize() const
+{
+#ifdef LOGCORE_MMAP
+	if (m_MappedFile)
+		return m_MappedFile->GetSize();
+#endif
+	return m_Size;
+}
+
+void CLogFile::Flush()
+{
+	if (m_File == nullptr || m_Buffer.empty())
+		return;
+
+	if (m_FlushCounter != nullptr)
+		m_FlushCounter->fetch_add(1, std::memory_order_relaxed);
+
+#ifdef LOGCORE_IO_URING
+	if (m_AsyncWriter != nullptr)
+	{
+		m_AsyncWriter->Write(*this);
+		return;
+	}
+#endif
+
+	std::fwrite(m_Buffer.data(), 1, m_Buffer.length(), m_File);
+	m_Buffer.clear();
+}
+
+void CLogFile::Sync(bool to_disk)
+{
+#ifdef LOGCORE_MMAP
+	if (m_MappedFile)
+	{
+		// the data is in the page cache already
+		if (to_disk)
+			m_MappedFile->Sync();
+		return;
+	}
+#endif
+
+	if (m_File == nullptr)
+		return;
+
+	Flush();
+#ifdef LOGCORE_IO_URING
+	if (m_AsyncWriter != nullptr)
+	{
+		m_AsyncWriter->Wait(*this);
+		if (!m_Buffer.empty())
+		{
+			m_AsyncWriter->Write(*this);
+			m_AsyncWriter->Wait(*this);
+		}
+	}
+#endif
+
+	if (!to_disk)
+		return;
+
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__)
+	_commit(_fileno(m_File));
+#elif defined(__APPLE__)
+	fsync(fileno(m_File));
+#else
+	fdatasync(fileno(m_File));
+#endif
+}
+
+
+CLogFile *CLogFileCache::Find(unsigned int key)
+{
+	auto it = m_Files.find(key);
+	if (it == m_Files.end())
+		return nullptr;
+
+	// move to front of LRU list
+	m_Lru.splice(m_Lru.begin(), m_Lru, it->second.lru_pos);
+	return it->second.file.get();
+}
+
+CLogFile &CLogFileCache::Open(unsigned int key, string filepath)
+{
+	if (m_Files.size() >= m_MaxOpenFiles && !m_Lru.empty())
+	{
+		// close least recently used file
+		m_Files.erase(m_Lru.back());
+		m_Lru.pop_back();
+	}
+
+	m_Lru.push_front(key);
+	Entry &entry = m_Files[key];
+	entry.file.reset(new CLogFile(std::move(filepath), true, m_FileBufferSize,
+		m_AsyncWriter, m_MappedSegmentSize));
+	entry.lru_pos = m_Lru.begin();
+	return *entry.file;
+}
+
+void CLogFileCache::Close(unsigned int key)
+{
+	auto it = m_Files.find(key);
+	if (it == m_Files.end())
+		return;
+
+	m_Lru.erase(it->second.lru_pos);
+	m_Files.erase(it);
+}
+
+void CLogFileCache::CloseIdle()
+{
+	const auto now = CLogFile::Clock::now();
+	while (!m_Lru.empty())
+	{
+		auto it = m_Files.find(m_Lru.back());
+		if (now - it->second.file->GetLastWriteTime() < m_IdleTimeout)
+			break;
+
+		m_Files.erase(it);
+		m_Lru.pop_back();
+	}
+}
+
+void CLogFileCache::FlushAll()
+{
+	for (auto &f : m_Files)
+		f.second.file->Flush();
+}
+
+void CLogFileCache::SyncAll(bool to_disk)
+{
+	for (auto &f : m_Files)
+		f.second.file->Sync(to_disk);
+}
+
+void CLogFileCache::CloseAll()
+{
+	m_Files.clear();
+	m_Lru.clear();
+}
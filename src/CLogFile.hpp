@@ -0,0 +1,174 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <memory>
+#include <list>
+#include <unordered_map>
+#include <chrono>
+#include <ctime>
+#include <atomic>
+
+using std::string;
+
+class CIoUringWriter;
+class CMappedFile;
+
+
+class CLogFile
+{
+	friend class CIoUringWriter;
+public:
+	using Clock = std::chrono::steady_clock;
+
+	// 'buffer_size' is the amount of bytes collected before they're written
+	// to the file, '0' writes everything through immediately;
+	// 'async_writer' takes over the actual writing if set;
+	// a 'mapped_segment_size' other than '0' writes the file through a
+	// memory mapping instead, growing it in segments of that size
+	CLogFile(string filepath, bool append, size_t buffer_size = 0,
+		CIoUringWriter *async_writer = nullptr, size_t mapped_segment_size = 0);
+	~CLogFile();
+	CLogFile(const CLogFile &rhs) = delete;
+	CLogFile &operator=(const CLogFile &rhs) = delete;
+
+public:
+	inline bool IsOpen() const
+	{
+#ifdef LOGCORE_MMAP
+		if (m_MappedFile)
+			return true;
+#endif
+		return m_File != nullptr;
+	}
+	inline string const &GetPath() const
+	{
+		return m_Path;
+	}
+	inline Clock::time_point GetLastWriteTime() const
+	{
+		return m_LastWriteTime;
+	}
+	inline bool HasPendingData() const
+	{
+		return !m_Buffer.empty();
+	}
+	// true if the file was empty when it was opened
+	inline bool IsNew() const
+	{
+		return m_IsNew;
+	}
+	// size of the file including buffered data
+	size_t GetSize() const;
+	// when the first data in this file was written (approximately)
+	inline std::time_t GetStartTime() const
+	{
+		return m_StartTime;
+	}
+	// 'counter' is increased every time buffered data gets written out
+	inline void SetFlushCounter(std::atomic<unsigned long long> *counter)
+	{
+		m_FlushCounter = counter;
+	}
+
+	void Write(const char *data, size_t length);
+	inline void Write(string const &data)
+	{
+		Write(data.data(), data.length());
+	}
+	// writes all buffered data to the file
+	void Flush();
+	// like Flush, but also waits until the OS has the data;
+	// 'to_disk' additionally waits until the data is on the disk
+	void Sync(bool to_disk);
+
+private:
+	// opens the file for regular writes
+	void OpenFile(bool append);
+
+private:
+	const string m_Path;
+	std::FILE *m_File = nullptr;
+	bool m_IsNew = true;
+	size_t m_Size = 0;
+	std::time_t m_StartTime;
+	Clock::time_point m_LastWriteTime;
+	std::atomic<unsigned long long> *m_FlushCounter = nullptr;
+
+#ifdef LOGCORE_MMAP
+	std::unique_ptr<CMappedFile> m_MappedFile;
+#endif
+
+	const size_t m_BufferSize;
+	string m_Buffer;
+
+	// state of asynchronous writes, managed by the async writer
+	CIoUringWriter * const m_AsyncWriter;
+	string m_WriteBuffer;
+	size_t m_WriteOffset = 0;
+	bool
+		m_WriteInProgress = false,
+		m_WriteRequested = false;
+};
+
+using LogFile_t = std::unique_ptr<CLogFile>;
+
+
+// keeps the most recently used log files open, so writing a message doesn't
+// cost an open/close every time; files are identified by module ID
+class CLogFileCache
+{
+public:
+	CLogFileCache(size_t max_open_files, CLogFile::Clock::duration idle_timeout,
+		size_t file_buffer_size) :
+		m_MaxOpenFiles(max_open_files > 0 ? max_open_files : 1),
+		m_IdleTimeout(idle_timeout),
+		m_FileBufferSize(file_buffer_size)
+	{ }
+	~CLogFileCache() = default;
+	CLogFileCache(const CLogFileCache &rhs) = delete;
+	CLogFileCache &operator=(const CLogFileCache &rhs) = delete;
+
+public:
+	inline void SetAsyncWriter(CIoUringWriter *async_writer)
+	{
+		m_AsyncWriter = async_writer;
+	}
+	inline void SetMappedSegmentSize(size_t segment_size)
+	{
+		m_MappedSegmentSize = segment_size;
+	}
+
+	// returns the already opened log file for 'key' or nullptr
+	CLogFile *Find(unsigned int key);
+	// opens 'filepath' and caches it as 'key', closes the least recently
+	// used file if the maximum number of open files is reached
+	CLogFile &Open(unsigned int key, string filepath);
+	void Close(unsigned int key);
+	// closes all files which haven't been written to since the idle timeout
+	void CloseIdle();
+	void CloseAll();
+	void FlushAll();
+	void SyncAll(bool to_disk);
+
+	inline size_t GetOpenCount() const
+	{
+		return m_Files.size();
+	}
+
+private:
+	struct Entry
+	{
+		LogFile_t file;
+		std::list<unsigned int>::iterator lru_pos;
+	};
+
+	const size_t m_MaxOpenFiles;
+	const CLogFile::Clock::duration m_IdleTimeout;
+	const size_t m_FileBufferSize;
+	CIoUringWriter *m_AsyncWriter = nullptr;
+	size_t m_MappedSegmentSize = 0;
+
+	std::unordered_map<unsigned int, Entry> m_Files;
+	std::list<unsigned int> m_Lru; // most recently used first
+};
@@ -0,0 +1,238 @@
+#include "CLogRotator.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <sys/stat.h>
+
+#include <fmt/format.h>
+#include <fmt/time.h>
+#include <tinydir/tinydir.h>
+
+#ifdef LOGCORE_ZLIB
+#  include <zlib.h>
+#endif
+
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__)
+#  define WIN32_LEAN_AND_MEAN
+#  include <Windows.h>
+#elif defined(__linux__)
+#  include <unistd.h>
+#  include <sys/syscall.h>
+#  include <sys/resource.h>
+#endif
+
+
+namespace
+{
+	void LowerThreadPriority()
+	{
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__)
+		SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_LOWEST);
+#elif defined(__linux__)
+		// on Linux, the nice value applies to single threads
+		setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 19);
+#endif
+	}
+
+	bool FileExists(string const &filepath)
+	{
+		struct stat st;
+		return stat(filepath.c_str(), &st) == 0;
+	}
+
+	// rotated files are named "<file>.<YYYYMMDD-HHMMSS>[-N][.gz]", 'name'
+	// is the part after "<file>."
+	bool IsRotatedFileOlder(string const &lhs, string const &rhs)
+	{
+		const size_t TimestampLength = 15;
+		const int time_cmp = lhs.compare(0, TimestampLength, rhs, 0, TimestampLength);
+		if (time_cmp != 0)
+			return time_cmp < 0;
+
+		auto get_counter = [](string const &name) -> unsigned long
+		{
+			if (name.length() <= TimestampLength || name[TimestampLength] != '-')
+				return 0;
+			return std::strtoul(name.c_str() + TimestampLength + 1, nullptr, 10);
+		};
+		return get_counter(lhs) < get_counter(rhs);
+	}
+}
+
+
+CLogRotator::CLogRotator(Policy const &policy) :
+	m_Policy(policy)
+{
+	if (IsEnabled())
+		m_Thread = std::thread(std::bind(&CLogRotator::Process, this));
+}
+
+CLogRotator::~CLogRotator()
+{
+	if (!m_Thread.joinable())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lg(m_QueueMtx);
+		m_Running = false;
+	}
+	m_QueueNotifier.notify_one();
+	m_Thread.join();
+}
+
+bool CLogRotator::NeedsRotation(CLogFile const &file)
+{
+	if (m_Policy.max_size != 0 && file.GetSize() >= m_Policy.max_size)
+		return true;
+
+	if (m_Policy.daily)
+	{
+		const std::time_t now = std::time(nullptr);
+		if (now >= m_NextDayStart)
+			UpdateDay(now);
+		return file.GetStartTime() < m_DayStart;
+	}
+	return false;
+}
+
+void CLogRotator::UpdateDay(std::time_t now)
+{
+	std::lock_guard<std::mutex> lg(m_DayMtx);
+	if (now < m_NextDayStart)
+		return; // another writer thread was faster
+
+	std::tm day = fmt::localtime(now);
+	day.tm_hour = day.tm_min = day.tm_sec = 0;
+	day.tm_isdst = -1;
+	const std::time_t day_start = std::mktime(&day);
+	day.tm_mday += 1;
+	day.tm_isdst = -1;
+	const std::time_t next_day_start = std::mktime(&day);
+
+	m_DayStart = day_start;
+	m_NextDayStart = next_day_start;
+}
+
+void CLogRotator::Rotate(string const &filepath)
+{
+	const string base_path = filepath + fmt::format(".{:%Y%m%d-%H%M%S}",
+		fmt::localtime(std::time(nullptr)));
+
+	string rotated_filepath = base_path;
+	for (unsigned int i = 1; FileExists(rotated_filepath)
+		|| FileExists(rotated_filepath + ".gz"); ++i)
+	{
+		rotated_filepath = base_path + "-" + std::to_string(i);
+	}
+
+	if (std::rename(filepath.c_str(), rotated_filepath.c_str()) != 0)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lg(m_QueueMtx);
+		m_Queue.push_back(Job{ filepath, std::move(rotated_filepath) });
+	}
+	m_QueueNotifier.notify_one();
+}
+
+void CLogRotator::Process()
+{
+	LowerThreadPriority();
+
+	std::unique_lock<std::mutex> lk(m_QueueMtx);
+	while (true)
+	{
+		m_QueueNotifier.wait(lk, [this]() { return !m_Running || !m_Queue.empty(); });
+		if (m_Queue.empty())
+			break; // not running anymore and nothing left to do
+
+		Job job = std::move(m_Queue.front());
+		m_Queue.pop_front();
+
+		lk.unlock();
+		if (m_Policy.compress)
+			Compress(job.rotated_filepath);
+		if (m_Policy.keep != 0)
+			RemoveOldFiles(job.filepath);
+		lk.lock();
+	}
+}
+
+void CLogRotator::Compress(string const &filepath)
+{
+#ifdef LOGCORE_ZLIB
+	std::FILE *file = std::fopen(filepath.c_str(), "rb");
+	if (file == nullptr)
+		return;
+
+	const string gz_filepath = filepath + ".gz";
+	gzFile gz_file = gzopen(gz_filepath.c_str(), "wb");
+	if (gz_file == nullptr)
+	{
+		std::fclose(file);
+		return;
+	}
+
+	bool success = true;
+	char buffer[64 * 1024];
+	size_t length;
+	while ((length = std::fread(buffer, 1, sizeof(buffer), file)) != 0)
+	{
+		if (gzwrite(gz_file, buffer, static_cast<unsigned int>(length)) == 0)
+		{
+			success = false;
+			break;
+		}
+	}
+
+	std::fclose(file);
+	if (gzclose(gz_file) != Z_OK)
+		success = false;
+
+	// keep the uncompressed file if anything went wrong
+	std::remove(success ? filepath.c_str() : gz_filepath.c_str());
+#else
+	(void)filepath;
+#endif
+}
+
+void CLogRotator::RemoveOldFiles(string const &filepath)
+{
+	const size_t separator_pos = filepath.find_last_of('/');
+	const string
+		directory = separator_pos != string::npos ? filepath.substr(0, separator_pos) : ".",
+		prefix = filepath.substr(separator_pos + 1) + ".";
+
+	std::vector<string> rotated_files;
+	tinydir_dir dir;
+	if (tinydir_open(&dir, directory.c_str()) != 0)
+		return;
+
+	while (dir.has_next)
+	{
+		tinydir_file file;
+		tinydir_readfile(&dir, &file);
+
+		const string name = file.name;
+		if (!file.is_dir && name.length() > prefix.length()
+			&& name.compare(0, prefix.length(), prefix) == 0
+			&& name[prefix.length()] >= '0' && name[prefix.length()] <= '9')
+		{
+			rotated_files.push_back(name.substr(prefix.length()));
+		}
+
+		tinydir_next(&dir);
+	}
+	tinydir_close(&dir);
+
+	if (rotated_files.size() <= m_Policy.keep)
+		return;
+
+	std::sort(rotated_files.begin(), rotated_files.end(), IsRotatedFileOlder);
+	const size_t remove_count = rotated_files.size() - m_Policy.keep;
+	for (size_t i = 0; i != remove_count; ++i)
+		std::remove((directory + "/" + prefix + rotated_files[i]).c_str());
+}
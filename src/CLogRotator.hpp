@@ -0,0 +1,71 @@
+#pragma once
+
+#include <string>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <ctime>
+
+#include "CLogFile.hpp"
+
+using std::string;
+
+
+// rotates log files by size and/or day; the writer threads only close and
+// rename a file, compressing it and deleting old ones is done by a
+// low-priority background thread
+class CLogRotator
+{
+public:
+	struct Policy
+	{
+		size_t max_size = 0; // in bytes, '0' disables rotation by size
+		bool daily = false;
+		unsigned int keep = 0; // number of rotated files kept, '0' keeps all
+		bool compress = false;
+	};
+
+	explicit CLogRotator(Policy const &policy);
+	// finishes all pending compressions
+	~CLogRotator();
+	CLogRotator(const CLogRotator &rhs) = delete;
+	CLogRotator &operator=(const CLogRotator &rhs) = delete;
+
+public:
+	inline bool IsEnabled() const
+	{
+		return m_Policy.max_size != 0 || m_Policy.daily;
+	}
+	bool NeedsRotation(CLogFile const &file);
+	// 'filepath' has to be closed already
+	void Rotate(string const &filepath);
+
+private:
+	void Process();
+	void UpdateDay(std::time_t now);
+	void Compress(string const &filepath);
+	void RemoveOldFiles(string const &filepath);
+
+private:
+	const Policy m_Policy;
+
+	// start of the current (local) day, only updated once it's over
+	std::mutex m_DayMtx;
+	std::atomic<std::time_t>
+		m_DayStart{ 0 },
+		m_NextDayStart{ 0 };
+
+	struct Job
+	{
+		string filepath;
+		string rotated_filepath;
+	};
+
+	std::thread m_Thread;
+	std::mutex m_QueueMtx;
+	std::condition_variable m_QueueNotifier;
+	std::deque<Job> m_Queue;
+	bool m_Running = true;
+};
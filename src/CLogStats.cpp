@@ -0,0 +1,57 @@
+#include "CLogStats.hpp"
+
+
+void CLatencyHistogram::Add(std::chrono::microseconds latency)
+{
+	const long long value = latency.count();
+	size_t bucket = 0;
+	if (value > 0)
+	{
+		// position of the highest set bit
+		unsigned long long v = static_cast<unsigned long long>(value);
+		while (v != 0 && bucket != BucketCount - 1)
+		{
+			v >>= 1;
+			++bucket;
+		}
+	}
+	m_Buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+void CLatencyHistogram::AddTo(unsigned long long *dest) const
+{
+	for (size_t i = 0; i != BucketCount; ++i)
+		dest[i] += m_Buckets[i].load(std::memory_order_relaxed);
+}
+
+unsigned long long CLatencyHistogram::GetPercentile(unsigned long long const *buckets,
+	double percentile)
+{
+	unsigned long long total = 0;
+	for (size_t i = 0; i != BucketCount; ++i)
+		total += buckets[i];
+	if (total == 0)
+		return 0;
+
+	const double threshold = total * percentile / 100.0;
+	unsigned long long count = 0;
+	for (size_t i = 0; i != BucketCount; ++i)
+	{
+		count += buckets[i];
+		if (count >= threshold)
+			return 1ull << i;
+	}
+	return 1ull << (BucketCount - 1);
+}
+
+
+void CModuleStats::AddTo(samplog_Stats &dest) const
+{
+	dest.messages_written += messages_written.load(std::memory_order_relaxed);
+	dest.bytes_written += bytes_written.load(std::memory_order_relaxed);
+	dest.flushes += flushes.load(std::memory_order_relaxed);
+	dest.dropped_messages += dropped_messages.load(std::memory_order_relaxed);
+	dest.duplicate_messages += duplicate_messages.load(std::memory_order_relaxed);
+	dest.rate_limited_messages += rate_limited_messages.load(std::memory_order_relaxed);
+	buffer_latency.AddTo(dest.buffer_latency_histogram);
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+
+#include <samplog/Stats.h>
+
+
+// counts the time from logging a message until it's written in log-scale
+// buckets: bucket 0 counts everything below 1 microsecond, bucket i
+// everything from 2^(i-1) up to 2^i microseconds, the last one everything above
+class CLatencyHistogram
+{
+public:
+	static const size_t BucketCount = SAMPLOG_LATENCY_BUCKETS;
+
+	CLatencyHistogram()
+	{
+		for (auto &b : m_Buckets)
+			b.store(0, std::memory_order_relaxed);
+	}
+	~CLatencyHistogram() = default;
+	CLatencyHistogram(const CLatencyHistogram &rhs) = delete;
+	CLatencyHistogram &operator=(const CLatencyHistogram &rhs) = delete;
+
+public:
+	void Add(std::chrono::microseconds latency);
+	// adds the bucket counts to 'dest'
+	void AddTo(unsigned long long *dest) const;
+
+	// upper bound (in microseconds) of the bucket containing the given
+	// percentile of 'buckets', 0 if there are no values
+	static unsigned long long GetPercentile(unsigned long long const *buckets,
+		double percentile);
+
+private:
+	std::atomic<unsigned long long> m_Buckets[BucketCount];
+};
+
+// updated by the writer thread responsible for the module,
+// dropped and rate limited messages are counted by the producers
+struct CModuleStats
+{
+	std::atomic<unsigned long long>
+		messages_written{ 0 },
+		bytes_written{ 0 },
+		flushes{ 0 },
+		dropped_messages{ 0 }, // in total, unlike CModule::dropped_messages
+		duplicate_messages{ 0 },
+		rate_limited_messages{ 0 }; // in total, unlike CModule::rate_limited_messages
+	CLatencyHistogram buffer_latency; // until the message is in the file buffer
+
+	// adds these stats to 'dest'
+	void AddTo(samplog_Stats &dest) const;
+};
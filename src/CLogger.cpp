@@ -1,30 +1,170 @@
 #include <algorithm>
-#include <fstream>
+#include <iterator>
+#include <cstring>
 #include <ctime>
-#include <set>
-
-#ifdef WIN32
-#  define WIN32_LEAN_AND_MEAN
-#  include <Windows.h>
-#else
-#  include <sys/stat.h>
-#endif
+#include <chrono>
+#include <limits>
 
 #include "CLogger.hpp"
 #include "CSampConfigReader.hpp"
+#include "binlog.hpp"
+#include "nativecall.hpp"
 #include "crashhandler.hpp"
-#include "amx/amx2.h"
 
 #include <fmt/format.h>
 #include <fmt/time.h>
 
+#if !(defined(WIN32) || defined(_WIN32) || defined(__WIN32__))
+#  include <fcntl.h>
+#  include <unistd.h>
+#  include <sys/stat.h>
+#  include "sigsafe.hpp"
+#endif
+#ifdef LOGCORE_MMAP
+#  include "CMappedFile.hpp"
+#endif
+
+
+namespace
+{
+	// maximum number of messages waiting for the writer thread, per producer thread
+	const int DefaultLogQueueCapacity = 16384;
+	// how long a producer waits for free queue space with the "block" policy
+	const int DefaultBlockTimeout = 1000; // in milliseconds
+	const std::chrono::microseconds
+		MinBlockBackoff(50),
+		MaxBlockBackoff(5000);
+	const std::chrono::seconds DroppedMessagesSummaryInterval(1);
+	const std::chrono::seconds RateLimitSummaryInterval(1);
+	const int DefaultStatsInterval = 60; // in seconds
+	// the writer thread re-checks the queue at least this often, in case
+	// a wakeup got lost
+	const std::chrono::milliseconds WriterIdleTimeout(100);
+	// messages are built in pre-allocated blocks of this size,
+	// bigger ones are allocated on the heap
+	const size_t MessageBlockSize = 512;
+	const size_t MessageBlockCount = 8192;
+	// maximum number of call info entries collected for a native call
+	const size_t MaxCallTraceDepth = 32;
+	// maximum size of the captured native call data, string parameters
+	// get truncated if they don't fit
+	const size_t MaxNativeCallSize = 4096;
+	// maximum number of messages the writer thread takes out of the queue at once
+	const size_t MaxBatchSize = 1024;
+	// module logs are spread over this many writer threads
+	const int DefaultWriterThreads = 1;
+	const int MaxWriterThreads = 16;
+
+	// limits for cached open module log files
+	const int DefaultMaxOpenFiles = 64;
+	const int DefaultFileIdleTimeout = 60; // in seconds
+	const std::chrono::seconds FileIdleCheckInterval(1);
+
+	// repeated messages are collapsed within this many milliseconds,
+	// '0' disables it
+	const int DefaultDuplicateWindow = 0;
+	// how often the writer thread reports repeats of messages which stopped
+	const std::chrono::milliseconds DuplicateExpiryCheckInterval(250);
+
+	// default flush policy: buffer up to 16 KB per file, write everything
+	// out at least every 500ms, write errors out immediately
+	const int DefaultFlushSize = 16; // in kilobytes
+	const int DefaultFlushInterval = 500; // in milliseconds
+	const LogLevel DefaultFlushLevel = LogLevel::ERROR;
+
+	// log rotation is disabled by default, if enabled
+	// the last 10 rotated files of every log are kept
+	const int DefaultRotateKeep = 10;
+
+	const char * const WarningLogPath = "logs/warnings.log";
+	const char * const ErrorLogPath = "logs/errors.log";
+	// recorded messages of disabled log levels start with this
+	const char * const FlightRecordMarker = "[recorded] ";
+	// how long the crash handler waits for the writer threads
+	// before it writes out the remaining messages itself
+	const std::chrono::milliseconds CrashFlushTimeout(500);
+
+#ifdef LOGCORE_IO_URING
+	const unsigned int IoUringQueueDepth = 256;
+#endif
+#ifdef LOGCORE_MMAP
+	// memory mapped log files grow in segments of this size
+	const int DefaultSegmentSize = 1024; // in kilobytes
+#endif
+
+	// values below 'min_value' are ignored, only options for
+	// which '0' means something allow it
+	int GetConfigValue(const char *varname, int default_value, int min_value = 1)
+	{
+		int value;
+		if (CSampConfigReader::Get()->GetVar(varname, value) && value >= min_value)
+			return value;
+		return default_value;
+	}
+
+	CLogRotator::Policy GetRotationPolicy()
+	{
+		CLogRotator::Policy policy;
+		policy.max_size = static_cast<size_t>(GetConfigValue("logcore_rotatesize", 0, 0)) * 1024;
+		policy.daily = GetConfigValue("logcore_rotatedaily", 0, 0) != 0;
+		policy.keep = GetConfigValue("logcore_rotatekeep", DefaultRotateKeep, 0);
+#ifdef LOGCORE_ZLIB
+		policy.compress = GetConfigValue("logcore_rotatecompress", 1, 0) != 0;
+#endif
+		return policy;
+	}
+
+	// messages are pushed into the queues with their timestamp as key, so
+	// the writer can merge the queues without touching unclaimed messages
+	inline int64_t GetQueueKey(Message_t const &msg)
+	{
+		return static_cast<int64_t>(msg->timestamp.time_since_epoch().count());
+	}
+
+	// every CLogManager instance gets its own generation, 0 is never used
+	std::atomic<unsigned int> LastGeneration{ 0 };
+	// generation of the current instance, 0 if there's none
+	std::atomic<unsigned int> LiveGeneration{ 0 };
+
+	// the producer queue of the current thread
+	struct ProducerQueueHandle
+	{
+		unsigned int generation = 0;
+		// nullptr if the thread uses the shared queue; shared with the
+		// manager, so the queue is still there if the manager is
+		// destroyed while this thread exits
+		std::shared_ptr<CProducerQueue> queue;
+
+		~ProducerQueueHandle()
+		{
+			// the thread exits, let another thread take over its queue
+			if (queue)
+				queue->in_use = false;
+		}
+	};
+	thread_local ProducerQueueHandle ThreadProducerQueue;
+}
+
 
 CLogManager::CLogManager() :
+	m_Rotator(GetRotationPolicy()),
+	m_FlushInterval(GetConfigValue("logcore_flushinterval", DefaultFlushInterval)),
+	m_ImmediateFlushLevels(GetLogLevelsFrom(DefaultFlushLevel)),
 	m_ThreadRunning(true),
-	m_DateTimeFormat("{:%x %X}")
+	m_MessagePool(MessageBlockSize, MessageBlockCount),
+	m_Generation(++LastGeneration),
+	m_QueueCapacity(GetConfigValue("logcore_queuesize", DefaultLogQueueCapacity)),
+	m_BlockTimeout(GetConfigValue("logcore_blocktimeout", DefaultBlockTimeout)),
+	m_StatsInterval(GetConfigValue("logcore_statsinterval", DefaultStatsInterval, 0)),
+	m_LogCoreModule(CModuleRegistry::Get()->Register("log-core"))
 {
+	LiveGeneration = m_Generation;
+#if !(defined(WIN32) || defined(_WIN32) || defined(__WIN32__))
+	std::fill(std::begin(m_CrashModuleFds), std::end(m_CrashModuleFds), -1);
+#endif
 	crashhandler::Install();
 
+	std::string date_time_format("{:%x %X}");
 	std::string cfg_time_format;
 	if (CSampConfigReader::Get()->GetVar("logtimeformat", cfg_time_format))
 	{
@@ -33,154 +173,1104 @@ CLogManager::CLogManager() :
 		while ((pos = cfg_time_format.find_first_of("[]()")) != std::string::npos)
 			cfg_time_format.erase(pos, 1);
 
-		m_DateTimeFormat = "{:" + cfg_time_format + "}";
+		date_time_format = "{:" + cfg_time_format + "}";
 		// quickly test out the format string
 		// will assert if invalid and on Windows
-		fmt::format(m_DateTimeFormat, fmt::localtime(std::time(nullptr)));
+		fmt::format(date_time_format, fmt::localtime(std::time(nullptr)));
 	}
 
-	CreateFolder("logs");
+	std::string cfg_flush_level;
+	LogLevel flush_level;
+	if (CSampConfigReader::Get()->GetVar("logcore_flushlevel", cfg_flush_level)
+		&& ParseLogLevel(cfg_flush_level, flush_level))
+	{
+		m_ImmediateFlushLevels = GetLogLevelsFrom(flush_level);
+	}
+
+	std::string cfg_output_format;
+	if (CSampConfigReader::Get()->GetVar("logcore_outputformat", cfg_output_format)
+		&& cfg_output_format == "binary")
+	{
+		m_OutputFormat = OutputFormat::BINARY;
+	}
+
+	int defer_native_calls;
+	if (CSampConfigReader::Get()->GetVar("logcore_defernativecalls", defer_native_calls))
+		m_DeferNativeCalls = defer_native_calls != 0;
+
+	std::string cfg_overflow_policy;
+	if (CSampConfigReader::Get()->GetVar("logcore_overflowpolicy", cfg_overflow_policy))
+	{
+		if (cfg_overflow_policy == "drop_newest")
+			m_OverflowPolicy = OverflowPolicy::DROP_NEWEST;
+		else if (cfg_overflow_policy == "drop_oldest")
+			m_OverflowPolicy = OverflowPolicy::DROP_OLDEST;
+		else if (cfg_overflow_policy == "drop_below_warning")
+			m_OverflowPolicy = OverflowPolicy::DROP_BELOW_WARNING;
+		else if (cfg_overflow_policy == "block")
+			m_OverflowPolicy = OverflowPolicy::BLOCK;
+	}
+
+	// also creates the "logs" folder
+	CModuleRegistry::Get();
 
-	m_WarningLog.open("logs/warnings.log");
-	m_ErrorLog.open("logs/errors.log");
+	const size_t writer_count = std::min(std::max(
+		GetConfigValue("logcore_writerthreads", DefaultWriterThreads), 1), MaxWriterThreads);
+	const size_t max_open_files = std::max(
+		GetConfigValue("logcore_maxopenfiles", DefaultMaxOpenFiles), 1);
+	const std::chrono::seconds file_idle_timeout(
+		GetConfigValue("logcore_fileidletime", DefaultFileIdleTimeout));
+	const size_t flush_size = GetConfigValue("logcore_flushsize", DefaultFlushSize, 0) * 1024;
+	const std::chrono::milliseconds duplicate_window(
+		GetConfigValue("logcore_duplicatewindow", DefaultDuplicateWindow, 0));
+	for (size_t i = 0; i != writer_count; ++i)
+	{
+		m_Writers.emplace_back(new Writer(i, m_QueueCapacity, max_open_files,
+			file_idle_timeout, flush_size, date_time_format, duplicate_window));
+	}
 
-	m_Thread = new std::thread(std::bind(&CLogManager::Process, this));
+	m_LevelLogBufferSize = flush_size;
+	std::string cfg_backend;
+	CSampConfigReader::Get()->GetVar("logcore_writebackend", cfg_backend);
+	if (cfg_backend == "io_uring")
+	{
+		bool available = false;
+#ifdef LOGCORE_IO_URING
+		available = true;
+		for (auto &w : m_Writers)
+		{
+			w->async_writer = CIoUringWriter::Create(IoUringQueueDepth);
+			if (!w->async_writer)
+				available = false;
+		}
+
+		for (auto &w : m_Writers)
+		{
+			if (!available)
+				w->async_writer.reset();
+			w->log_files.SetAsyncWriter(w->async_writer.get());
+		}
+
+		// an io_uring instance may only be used by a single thread, so
+		// warnings.log and errors.log can only use it if there's just one writer
+		if (m_Writers.size() == 1)
+			m_LevelLogAsyncWriter = m_Writers.front()->async_writer.get();
+#endif
+		if (!available)
+		{
+			const std::string msg = "io_uring is not available, falling back to the default writer backend";
+			QueueLogMessage(m_LogCoreModule,
+				LogLevel::WARNING, msg.c_str(), msg.length());
+		}
+	}
+	else if (cfg_backend == "mmap")
+	{
+#ifdef LOGCORE_MMAP
+		const size_t mapped_segment_size = std::max(
+			GetConfigValue("logcore_segmentsize", DefaultSegmentSize), 1) * 1024;
+		m_LevelLogSegmentSize = mapped_segment_size;
+		// after a crash, the end of a binary log couldn't be told apart
+		// from the unused preallocated space, so those are written normally
+		if (m_OutputFormat == OutputFormat::TEXT)
+		{
+			for (auto &w : m_Writers)
+				w->log_files.SetMappedSegmentSize(mapped_segment_size);
+		}
+#else
+		const std::string msg = "mmap is not available, falling back to the default writer backend";
+		QueueLogMessage(m_LogCoreModule,
+			LogLevel::WARNING, msg.c_str(), msg.length());
+#endif
+	}
+
+	m_WarningLog.reset(new CLogFile(WarningLogPath, true, m_LevelLogBufferSize,
+		m_LevelLogAsyncWriter, m_LevelLogSegmentSize));
+	m_ErrorLog.reset(new CLogFile(ErrorLogPath, true, m_LevelLogBufferSize,
+		m_LevelLogAsyncWriter, m_LevelLogSegmentSize));
+	m_WarningLog->SetFlushCounter(&m_LevelLogStats.flushes);
+	m_ErrorLog->SetFlushCounter(&m_LevelLogStats.flushes);
+
+	for (auto &w : m_Writers)
+		w->thread = std::thread(std::bind(&CLogManager::Process, this, std::ref(*w)));
 }
 
 CLogManager::~CLogManager()
 {
+	for (auto &w : m_Writers)
 	{
-		std::lock_guard<std::mutex> lg(m_QueueMtx);
+		std::lock_guard<std::mutex> lg(w->sleep_mtx);
 		m_ThreadRunning = false;
+		w->notifier.notify_one();
 	}
-	m_QueueNotifier.notify_one();
-	m_Thread->join();
-	delete m_Thread;
+	for (auto &w : m_Writers)
+		w->thread.join();
+
+	// the log files have to be closed before the async writers go away
+	m_WarningLog.reset();
+	m_ErrorLog.reset();
+
+	LiveGeneration = 0;
+}
+
+void CLogManager::QueueLogMessage(ModuleId module, LogLevel level,
+	const char *text, size_t text_length,
+	AmxFuncCallInfo const *call_info /*= nullptr*/, size_t call_info_count /*= 0*/)
+{
+	QueueLogMessage(CMessage::Create(m_MessagePool, module, level,
+		text, text_length, call_info, call_info_count));
+}
+
+bool CLogManager::QueueNativeCall(ModuleId module, AMX * const amx,
+	cell * const params, const char *name, const char *params_format)
+{
+	char data[MaxNativeCallSize];
+	const size_t length = nativecall::Capture(amx, params, name, params_format,
+		MaxCallTraceDepth, data, sizeof(data));
+	if (length == 0)
+		return false;
+
+	Message_t msg = CMessage::CreateNativeCall(m_MessagePool, module, LogLevel::DEBUG,
+		data, length);
+	if (!m_DeferNativeCalls)
+		msg = nativecall::Format(m_MessagePool, *msg);
+
+	QueueLogMessage(std::move(msg));
+	return true;
 }
 
 void CLogManager::QueueLogMessage(Message_t &&msg)
 {
+	Writer &writer = GetWriter(msg->log_module);
+	CRingBuffer<Message_t> &queue = GetProducerQueue(writer);
+	const int64_t key = GetQueueKey(msg);
+	if (!queue.TryPush(std::move(msg), key) && !HandleQueueOverflow(queue, msg))
+		return;
+
+	// pairs with the fence in Process, so either we see the writer
+	// going to sleep or the writer sees our message
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (writer.sleeping.load(std::memory_order_relaxed))
+	{
+		std::lock_guard<std::mutex> lg(writer.sleep_mtx);
+		writer.notifier.notify_one();
+	}
+}
+
+CRingBuffer<Message_t> &CLogManager::GetProducerQueue(Writer &writer)
+{
+	ProducerQueueHandle &handle = ThreadProducerQueue;
+	if (handle.generation != m_Generation)
 	{
-		std::lock_guard<std::mutex> lg(m_QueueMtx);
-		m_LogMsgQueue.push(std::move(msg));
+		handle.generation = m_Generation;
+		handle.queue = ClaimProducerQueue();
 	}
-	m_QueueNotifier.notify_one();
+	if (handle.queue == nullptr)
+		return writer.shared_queue;
+	return *handle.queue->queues[writer.index];
 }
 
-void CLogManager::Process()
+std::shared_ptr<CProducerQueue> CLogManager::ClaimProducerQueue()
 {
-	std::unique_lock<std::mutex> lk(m_QueueMtx);
-	std::set<size_t> HashedModules;
-	std::hash<std::string> StringHash;
+	std::lock_guard<std::mutex> lg(m_ProducerQueueMtx);
 
-	do
+	// take over the queue of a thread which already exited,
+	// the writer threads still drain what it left behind
+	const size_t count = m_ProducerQueueCount.load(std::memory_order_relaxed);
+	for (size_t i = 0; i != count; ++i)
+	{
+		std::shared_ptr<CProducerQueue> const &queue = m_ProducerQueues[i];
+		if (!queue->in_use)
+		{
+			queue->in_use = true;
+			return queue;
+		}
+	}
+
+	if (count == MaxProducerQueues)
+		return nullptr;
+
+	m_ProducerQueues[count] = std::make_shared<CProducerQueue>(m_Writers.size(), m_QueueCapacity);
+	// publishes the new queue to the writer threads
+	m_ProducerQueueCount.store(count + 1, std::memory_order_release);
+	return m_ProducerQueues[count];
+}
+
+bool CLogManager::HandleQueueOverflow(CRingBuffer<Message_t> &queue, Message_t &msg)
+{
+	const int64_t key = GetQueueKey(msg);
+	OverflowPolicy policy = m_OverflowPolicy;
+	if (policy == OverflowPolicy::DROP_BELOW_WARNING)
+	{
+		policy = (msg->loglevel & GetLogLevelsFrom(LogLevel::WARNING))
+			? OverflowPolicy::BLOCK : OverflowPolicy::DROP_NEWEST;
+	}
+
+	switch (policy)
 	{
-		m_QueueNotifier.wait(lk);
-		while (!m_LogMsgQueue.empty())
+	case OverflowPolicy::DROP_OLDEST:
+		do
 		{
-			Message_t msg = std::move(m_LogMsgQueue.front());
-			m_LogMsgQueue.pop();
+			Message_t oldest;
+			if (queue.TryPop(oldest))
+				CountDroppedMessage(oldest->log_module);
+		} while (!queue.TryPush(std::move(msg), key));
+		return true;
 
-			//manually unlock mutex
-			//the whole write-to-file code below has no need to be locked with the
-			//message queue mutex; while writing to the log file, new messages can
-			//now be queued
-			lk.unlock();
+	case OverflowPolicy::BLOCK:
+	{
+		// the writer needs a while to make room if the disk is slow,
+		// back off instead of burning the producer's core
+		const auto deadline = std::chrono::steady_clock::now() + m_BlockTimeout;
+		std::chrono::microseconds backoff(MinBlockBackoff);
+		do
+		{
+			std::this_thread::sleep_for(backoff);
+			if (queue.TryPush(std::move(msg), key))
+				return true;
+			backoff = std::min(backoff * 2, MaxBlockBackoff);
+		} while (std::chrono::steady_clock::now() < deadline);
+	}	break;
+
+	case OverflowPolicy::DROP_NEWEST:
+	default:
+		break;
+	}
+
+	CountDroppedMessage(msg->log_module);
+	return false;
+}
+
+void CLogManager::CountDroppedMessage(ModuleId module)
+{
+	CModule *mod = CModuleRegistry::Get()->GetModule(module);
+	if (mod != nullptr)
+	{
+		++mod->dropped_messages;
+		mod->stats.dropped_messages.fetch_add(1, std::memory_order_relaxed);
+	}
+	++m_DroppedMessages;
+}
+
+size_t CLogManager::DrainQueues(Writer &writer, std::vector<Message_t> &dest, bool &saturated)
+{
+	// the producer queues, then the shared queue
+	const size_t queue_count = m_ProducerQueueCount.load(std::memory_order_acquire) + 1;
+	auto get_queue = [&](size_t index) -> CRingBuffer<Message_t> &
+	{
+		if (index == queue_count - 1)
+			return writer.shared_queue;
+		return *m_ProducerQueues[index]->queues[writer.index];
+	};
+
+	// the queues are drained one after another, so a message pushed to a queue
+	// drained later could be newer than one pushed to an already drained queue
+	// meanwhile; only messages from before the drain started are taken (never
+	// going back in time, or a clock adjustment would hold messages back)
+	writer.drain_start = std::max(writer.drain_start, static_cast<int64_t>(
+		std::chrono::system_clock::now().time_since_epoch().count()));
+
+	// a queue with more than a batch worth of messages only gives up its
+	// oldest batch; nothing newer than that may be written from the other
+	// queues either, or it would end up before the older messages left behind
+	saturated = false;
+	size_t queue_depth = 0;
+	int64_t cutoff = writer.drain_start;
+	for (size_t i = 0; i != queue_count; ++i)
+	{
+		CRingBuffer<Message_t> &queue = get_queue(i);
+		queue_depth += queue.GetSize();
+		// only the key, the message could be dropped (DROP_OLDEST) or
+		// taken by the crash handler meanwhile
+		int64_t last_timestamp;
+		if (queue.PeekKey(MaxBatchSize - 1, last_timestamp))
+		{
+			saturated = true;
+			cutoff = std::min(cutoff, last_timestamp);
+		}
+	}
+
+	// queues only grow until they're drained, so this is the peak
+	// since the last time
+	writer.queue_depth.store(queue_depth, std::memory_order_relaxed);
+	if (queue_depth > writer.queue_high_water.load(std::memory_order_relaxed))
+		writer.queue_high_water.store(queue_depth, std::memory_order_relaxed);
+
+	std::vector<DrainRun> &runs = writer.drain_runs;
+	runs.clear();
+	for (size_t i = 0; i != queue_count; ++i)
+	{
+		CRingBuffer<Message_t> &queue = get_queue(i);
+		const size_t begin = dest.size();
+		queue.TryPopBatchWhile(dest, queue.GetCapacity(), [cutoff](int64_t timestamp)
+		{
+			return timestamp <= cutoff;
+		});
+		if (dest.size() != begin)
+			runs.push_back({ begin, dest.size() });
+	}
 
-			std::string timestamp;
-			std::time_t now_c = std::chrono::system_clock::to_time_t(msg->timestamp);
-			timestamp = fmt::format(m_DateTimeFormat, fmt::localtime(now_c));
+	// every queue is in chronological order by itself, merge them
+	if (runs.size() > 1)
+	{
+		// the heap's top is the run with the oldest next message
+		auto later = [&dest](DrainRun const &lhs, DrainRun const &rhs)
+		{
+			if (dest[lhs.begin]->timestamp != dest[rhs.begin]->timestamp)
+				return dest[rhs.begin]->timestamp < dest[lhs.begin]->timestamp;
+			return rhs.begin < lhs.begin;
+		};
+
+		std::vector<Message_t> &merged = writer.merge_buffer;
+		merged.clear();
+		std::make_heap(runs.begin(), runs.end(), later);
+		while (!runs.empty())
+		{
+			std::pop_heap(runs.begin(), runs.end(), later);
+			DrainRun &run = runs.back();
+			merged.push_back(std::move(dest[run.begin++]));
+			if (run.begin == run.end)
+				runs.pop_back();
+			else
+				std::push_heap(runs.begin(), runs.end(), later);
+		}
+		dest.swap(merged);
+	}
+	return dest.size();
+}
 
-			const char *loglevel_str = "<unknown>";
-			switch (msg->loglevel)
+bool CLogManager::AreQueuesEmpty(Writer const &writer) const
+{
+	const size_t queue_count = m_ProducerQueueCount.load(std::memory_order_acquire);
+	for (size_t i = 0; i != queue_count; ++i)
+	{
+		if (!m_ProducerQueues[i]->queues[writer.index]->IsEmpty())
+			return false;
+	}
+	return writer.shared_queue.IsEmpty();
+}
+
+void CLogManager::Process(Writer &writer)
+{
+	std::vector<Message_t> batch;
+	batch.reserve(MaxBatchSize);
+	auto last_idle_check = CLogFile::Clock::now();
+	auto last_flush = last_idle_check;
+	auto last_drop_summary = last_idle_check;
+	auto last_rate_limit_summary = last_idle_check;
+	auto last_stats = last_idle_check;
+	auto last_duplicate_check = last_idle_check;
+	auto const wakeup_interval = std::min<CLogFile::Clock::duration>(WriterIdleTimeout,
+		std::max(m_FlushInterval, std::chrono::milliseconds(1)));
+
+	bool running;
+	bool saturated;
+	size_t batch_size;
+	do
+	{
+		// read the flag before draining the queue, so no message
+		// queued before shutdown gets lost
+		running = m_ThreadRunning;
+		// same for flush requests and crashes
+		const unsigned int flush_requests = writer.flush_requests.load();
+		const bool crashed = m_Crashed;
+
+		// take over everything that's pending in one go instead of
+		// popping message by message
+		batch_size = DrainQueues(writer, batch, saturated);
+		if (batch_size != 0)
+		{
+			++m_BatchCount;
+			m_BatchedMessageCount += batch_size;
+			size_t max_batch_size = m_MaxBatchSize;
+			while (batch_size > max_batch_size
+				&& !m_MaxBatchSize.compare_exchange_weak(max_batch_size, batch_size))
+			{ }
+
+			for (auto const &msg : batch)
 			{
-			case LogLevel::DEBUG:
-				loglevel_str = "DEBUG";
-				break;
-			case LogLevel::INFO:
-				loglevel_str = "INFO";
-				break;
-			case LogLevel::WARNING:
-				loglevel_str = "WARNING";
-				break;
-			case LogLevel::ERROR:
-				loglevel_str = "ERROR";
-				break;
+				if (CheckDuplicate(writer, msg))
+					WriteMessage(writer, msg);
 			}
+			batch.clear();
+		}
 
-			const string &modulename = msg->log_module;
-			size_t module_hash = StringHash(modulename);
-			if (HashedModules.find(module_hash) == HashedModules.end())
+		auto now = CLogFile::Clock::now();
+		// only report dropped messages once the queue pressure is gone
+		if (!saturated && m_DroppedMessages != 0
+			&& now - last_drop_summary >= DroppedMessagesSummaryInterval)
+		{
+			WriteDroppedMessagesSummary(writer);
+			last_drop_summary = now;
+		}
+		if (CModuleRegistry::Get()->HasRateLimits()
+			&& now - last_rate_limit_summary >= RateLimitSummaryInterval)
+		{
+			WriteRateLimitSummary(writer);
+			last_rate_limit_summary = now;
+		}
+		if (&writer == &GetWriter(m_LogCoreModule)
+			&& CModuleRegistry::Get()->TakeLimitReached())
+		{
+			WriteModuleLimitError(writer);
+		}
+		if (m_StatsInterval.count() != 0 && now - last_stats >= m_StatsInterval)
+		{
+			WriteStats(writer);
+			last_stats = now;
+		}
+		if (now - last_flush >= m_FlushInterval)
+		{
+			FlushAll(writer);
+			last_flush = now;
+		}
+		if (now - last_idle_check >= FileIdleCheckInterval)
+		{
+			writer.log_files.CloseIdle();
+			last_idle_check = now;
+		}
+		if (writer.duplicates.IsEnabled()
+			&& now - last_duplicate_check >= DuplicateExpiryCheckInterval)
+		{
+			writer.duplicates.Expire(std::chrono::system_clock::now(),
+				[&](CDuplicateFilter::Entry const &e) { WriteRepeatSummary(writer, e); });
+			last_duplicate_check = now;
+		}
+		// as long as somebody waits, everything drained gets written right away
+		if (flush_requests != writer.handled_flush_requests || writer.flush_waiters != 0)
+		{
+			SyncAll(writer, writer.sync_waiters != 0);
+			writer.handled_flush_requests = flush_requests;
+			last_flush = now;
+		}
+		// once everything queued before the crash is written, the crash
+		// handler takes over the queues, see WriteOutOnCrash
+		if (crashed && !saturated)
+		{
+			SyncAll(writer, false);
+			writer.crash_flushed = true;
+			while (m_ThreadRunning)
+				std::this_thread::sleep_for(wakeup_interval);
+		}
+
+#ifdef LOGCORE_IO_URING
+		// hand all writes queued up while processing this batch
+		// to the kernel in one go
+		if (writer.async_writer)
+			writer.async_writer->Submit();
+#endif
+
+		if (running)
+		{
+			std::unique_lock<std::mutex> lk(writer.sleep_mtx);
+			writer.sleeping.store(true, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (m_ThreadRunning && AreQueuesEmpty(writer)
+				&& writer.flush_requests == writer.handled_flush_requests)
 			{
-				//create possibly non-existing folders before opening log file
-				size_t pos = 0;
-				while ((pos = modulename.find('/', pos)) != std::string::npos)
-				{
-					CreateFolder("logs/" + modulename.substr(0, pos++));
-				}
-
-				HashedModules.insert(module_hash);
+				writer.notifier.wait_for(lk, wakeup_interval);
 			}
+			writer.sleeping.store(false, std::memory_order_relaxed);
+		}
+	} while (running || batch_size != 0);
+
+	writer.duplicates.ExpireAll(
+		[&](CDuplicateFilter::Entry const &e) { WriteRepeatSummary(writer, e); });
+	if (m_DroppedMessages != 0)
+		WriteDroppedMessagesSummary(writer);
+	if (CModuleRegistry::Get()->HasRateLimits())
+		WriteRateLimitSummary(writer);
+	FlushAll(writer);
+	writer.log_files.CloseAll();
+}
+
+bool CLogManager::CheckDuplicate(Writer &writer, Message_t const &msg)
+{
+	// native calls are traces, every single one counts
+	if (!writer.duplicates.IsEnabled() || msg->type != CMessage::Type::TEXT)
+		return true;
+
+	if (writer.duplicates.Check(*msg,
+		[&](CDuplicateFilter::Entry const &e) { WriteRepeatSummary(writer, e); }))
+	{
+		return true;
+	}
+
+	CModule *module = CModuleRegistry::Get()->GetModule(msg->log_module);
+	if (module != nullptr)
+		module->stats.duplicate_messages.fetch_add(1, std::memory_order_relaxed);
+	return false;
+}
+
+void CLogManager::WriteRepeatSummary(Writer &writer, CDuplicateFilter::Entry const &entry)
+{
+	fmt::MemoryWriter text;
+	text << "last message repeated " << entry.repeats << " times: "
+		<< fmt::StringRef(entry.text, std::min(entry.text_length, CDuplicateFilter::MaxTextLength));
+	if (entry.text_length > CDuplicateFilter::MaxTextLength)
+		text << "...";
+
+	const size_t call_info_count = entry.call_site.file != nullptr ? 1 : 0;
+	WriteMessage(writer, CMessage::Create(m_MessagePool, entry.last_seen, entry.module,
+		entry.level, text.data(), text.size(), &entry.call_site, call_info_count));
+}
+
+void CLogManager::WriteDroppedMessagesSummary(Writer &writer)
+{
+	// every writer thread reports the modules it's responsible for
+	CModuleRegistry *registry = CModuleRegistry::Get();
+	const ModuleId last_id = registry->GetLastModuleId();
+	for (ModuleId id = 1; id <= last_id; ++id)
+	{
+		if (&GetWriter(id) != &writer)
+			continue;
+
+		CModule *module = registry->GetModule(id);
+		const unsigned int count = module->dropped_messages.exchange(0);
+		if (count == 0)
+			continue;
+
+		const std::string text = fmt::format(
+			"{} messages dropped because the log queue was full", count);
+		WriteMessage(writer, CMessage::Create(m_MessagePool, id, LogLevel::WARNING,
+			text.c_str(), text.length()));
+	}
+
+	if (&GetWriter(m_LogCoreModule) != &writer)
+		return;
+
+	const unsigned int total = m_DroppedMessages.exchange(0);
+	if (total == 0)
+		return;
+
+	const std::string text = fmt::format(
+		"{} messages dropped in total because the log queue was full", total);
+	WriteMessage(writer, CMessage::Create(m_MessagePool, m_LogCoreModule,
+		LogLevel::WARNING, text.c_str(), text.length()));
+}
+
+void CLogManager::WriteRateLimitSummary(Writer &writer)
+{
+	// the over-budget messages were never queued, so there's
+	// nothing to wait for; the total is part of the stats line
+	CModuleRegistry *registry = CModuleRegistry::Get();
+	const ModuleId last_id = registry->GetLastModuleId();
+	for (ModuleId id = 1; id <= last_id; ++id)
+	{
+		if (&GetWriter(id) != &writer)
+			continue;
+
+		CModule *module = registry->GetModule(id);
+		const unsigned int count = module->rate_limited_messages.exchange(0);
+		if (count == 0)
+			continue;
+
+		const std::string text = fmt::format(
+			"{} messages not written because they exceeded the rate limit", count);
+		WriteMessage(writer, CMessage::Create(m_MessagePool, id, LogLevel::WARNING,
+			text.c_str(), text.length()));
+	}
+}
+
+void CLogManager::WriteModuleLimitError(Writer &writer)
+{
+	// the modules over the limit can't log anything themselves
+	const std::string text = fmt::format("can't register more than {} modules, "
+		"all messages of further modules are discarded", CModuleRegistry::MaxModules);
+	WriteMessage(writer, CMessage::Create(m_MessagePool, m_LogCoreModule,
+		LogLevel::ERROR, text.c_str(), text.length()));
+}
+
+void CLogManager::WriteStats(Writer &writer)
+{
+	// the stats of everything go into the log-core log
+	if (&GetWriter(m_LogCoreModule) != &writer)
+		return;
+
+	samplog_Stats stats;
+	GetStats(InvalidModuleId, stats);
+
+	const unsigned long long *latency = stats.buffer_latency_histogram;
+	const std::string text = fmt::format("stats: {} messages ({} bytes) written, "
+		"{} flushes, {} dropped, {} rate limited, {} repeats collapsed, queue depth {} (max {}), "
+		"{} batches (max {} messages), buffer latency p50 <{}us p99 <{}us p999 <{}us",
+		stats.messages_written, stats.bytes_written, stats.flushes,
+		stats.dropped_messages, stats.rate_limited_messages, stats.duplicate_messages,
+		stats.queue_depth, stats.queue_high_water,
+		stats.batches, stats.max_batch_size,
+		CLatencyHistogram::GetPercentile(latency, 50.0),
+		CLatencyHistogram::GetPercentile(latency, 99.0),
+		CLatencyHistogram::GetPercentile(latency, 99.9));
+	WriteMessage(writer, CMessage::Create(m_MessagePool, m_LogCoreModule,
+		LogLevel::INFO, text.c_str(), text.length()));
+}
+
+bool CLogManager::GetStats(ModuleId module, samplog_Stats &dest) const
+{
+	dest = samplog_Stats();
+	dest.size = sizeof(samplog_Stats);
+	CModuleRegistry *registry = CModuleRegistry::Get();
+
+	if (module != InvalidModuleId)
+	{
+		CModule *mod = registry->GetModule(module);
+		if (mod == nullptr)
+			return false;
+
+		mod->stats.AddTo(dest);
+		if (mod->rate_limiter)
+		{
+			dest.rate_limit = mod->rate_limiter->GetRate();
+			dest.rate_limit_tokens = mod->rate_limiter->GetAvailableTokens();
+		}
+		Writer const &writer = *m_Writers[module % m_Writers.size()];
+		dest.queue_depth = writer.queue_depth.load(std::memory_order_relaxed);
+		dest.queue_high_water = writer.queue_high_water.load(std::memory_order_relaxed);
+		return true;
+	}
+
+	const ModuleId last_id = registry->GetLastModuleId();
+	for (ModuleId id = 1; id <= last_id; ++id)
+		registry->GetModule(id)->stats.AddTo(dest);
+	m_LevelLogStats.AddTo(dest);
+
+	for (auto const &w : m_Writers)
+	{
+		dest.queue_depth += w->queue_depth.load(std::memory_order_relaxed);
+		dest.queue_high_water = std::max<unsigned long long>(dest.queue_high_water,
+			w->queue_high_water.load(std::memory_order_relaxed));
+	}
+	dest.batches = m_BatchCount.load(std::memory_order_relaxed);
+	dest.batched_messages = m_BatchedMessageCount.load(std::memory_order_relaxed);
+	dest.max_batch_size = m_MaxBatchSize.load(std::memory_order_relaxed);
+	return true;
+}
+
+void CLogManager::FlushAll(Writer &writer)
+{
+	writer.log_files.FlushAll();
+
+	std::lock_guard<std::mutex> lg(m_LevelLogMtx);
+	m_WarningLog->Flush();
+	m_ErrorLog->Flush();
+}
 
-			// build log string
-			fmt::MemoryWriter log_string;
+void CLogManager::SyncAll(Writer &writer, bool to_disk)
+{
+	writer.log_files.SyncAll(to_disk);
+	{
+		std::lock_guard<std::mutex> lg(m_LevelLogMtx);
+		m_WarningLog->Sync(to_disk);
+		m_ErrorLog->Sync(to_disk);
+	}
 
-			log_string << msg->text;
-			if (!msg->call_info.empty())
+	const size_t queue_count = m_ProducerQueueCount.load(std::memory_order_acquire);
+	for (size_t i = 0; i != queue_count; ++i)
+	{
+		CRingBuffer<Message_t> &queue = *m_ProducerQueues[i]->queues[writer.index];
+		queue.SetProcessedPosition(queue.GetTailPosition());
+	}
+	writer.shared_queue.SetProcessedPosition(writer.shared_queue.GetTailPosition());
+
+	// the lock makes sure a Flush call can't miss the notification
+	{
+		std::lock_guard<std::mutex> lg(m_FlushMtx);
+	}
+	m_FlushNotifier.notify_all();
+}
+
+bool CLogManager::Flush(std::chrono::milliseconds timeout, bool sync)
+{
+	const auto deadline = std::chrono::steady_clock::now() + timeout;
+
+	// every message queued so far has a lower position than these
+	std::vector<std::pair<CRingBuffer<Message_t> const *, size_t>> watermarks;
+	const size_t queue_count = m_ProducerQueueCount.load(std::memory_order_acquire);
+	for (auto &w : m_Writers)
+	{
+		for (size_t i = 0; i != queue_count; ++i)
+		{
+			CRingBuffer<Message_t> const &queue = *m_ProducerQueues[i]->queues[w->index];
+			watermarks.emplace_back(&queue, queue.GetHeadPosition());
+		}
+		watermarks.emplace_back(&w->shared_queue, w->shared_queue.GetHeadPosition());
+	}
+
+	for (auto &w : m_Writers)
+	{
+		++w->flush_waiters;
+		if (sync)
+			++w->sync_waiters;
+		++w->flush_requests;
+
+		// same as in QueueLogMessage
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (w->sleeping.load(std::memory_order_relaxed))
+		{
+			std::lock_guard<std::mutex> lg(w->sleep_mtx);
+			w->notifier.notify_one();
+		}
+	}
+
+	bool done;
+	{
+		std::unique_lock<std::mutex> lk(m_FlushMtx);
+		done = m_FlushNotifier.wait_until(lk, deadline, [&watermarks]()
+		{
+			for (auto const &w : watermarks)
 			{
-				log_string << " (";
-				bool first = true;
-				for (auto const &ci : msg->call_info)
-				{
-					if (!first)
-						log_string << " -> ";
-					log_string << ci.file << ":" << ci.line;
-					first = false;
-				}
-				log_string << ")";
+				if (w.first->GetProcessedPosition() < w.second)
+					return false;
 			}
+			return true;
+		});
+	}
 
-			//default logging
-			std::ofstream logfile("logs/" + modulename + ".log",
-				std::ofstream::out | std::ofstream::app);
-			logfile <<
-				"[" << timestamp << "] " <<
-				"[" << loglevel_str << "] " <<
-				log_string.str() << '\n' << std::flush;
+	for (auto &w : m_Writers)
+	{
+		--w->flush_waiters;
+		if (sync)
+			--w->sync_waiters;
+	}
+	return done;
+}
 
+#if !(defined(WIN32) || defined(_WIN32) || defined(__WIN32__))
+void CLogManager::WriteOutOnCrash(const char *reason, size_t reason_length)
+{
+	m_Crashed = true;
 
-			//per-log-level logging
-			std::ofstream *loglevel_file = nullptr;
-			if (msg->loglevel & LogLevel::WARNING)
-				loglevel_file = &m_WarningLog;
-			else if (msg->loglevel & LogLevel::ERROR)
-				loglevel_file = &m_ErrorLog;
+	// the writer threads still write out everything they have the regular
+	// way, unless they're stuck or the crash happened on one of them
+	const auto deadline = std::chrono::steady_clock::now() + CrashFlushTimeout;
+	for (auto &w : m_Writers)
+	{
+		if (w->thread.get_id() == std::this_thread::get_id())
+			continue;
+		while (!w->crash_flushed && std::chrono::steady_clock::now() < deadline)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	// whatever is still queued now gets written from here
+	const size_t queue_count = m_ProducerQueueCount.load(std::memory_order_acquire);
+	for (auto &w : m_Writers)
+	{
+		for (size_t i = 0; i != queue_count; ++i)
+			DrainQueueOnCrash(*m_ProducerQueues[i]->queues[w->index]);
+		DrainQueueOnCrash(w->shared_queue);
+	}
+
+	const auto now = std::chrono::system_clock::now();
+	CModuleRegistry *registry = CModuleRegistry::Get();
+	const ModuleId last_id = registry->GetLastModuleId();
+	for (ModuleId id = 1; id <= last_id; ++id)
+	{
+		CModule *recorder_module = registry->GetModule(id);
+		if (recorder_module != nullptr && recorder_module->flight_recorder)
+			WriteFlightRecordsOnCrash(*recorder_module, now);
+	}
+
+	CModule *module = registry->GetModule(m_LogCoreModule);
+	if (module == nullptr)
+		return;
+
+	WriteLineOnCrash(m_CrashModuleFds[module->id], module->file_path.c_str(),
+		now, LogLevel::ERROR, nullptr, reason, reason_length, nullptr, 0);
+	WriteLineOnCrash(m_CrashErrorFd, ErrorLogPath,
+		now, LogLevel::ERROR, module->prefix.c_str(), reason, reason_length, nullptr, 0);
+}
+
+void CLogManager::DrainQueueOnCrash(CRingBuffer<Message_t> &queue)
+{
+	// other threads might still be logging, only take what's there now
+	const size_t end = queue.GetHeadPosition();
+	Message_t msg;
+	while (queue.GetTailPosition() < end && queue.TryPop(msg))
+	{
+		WriteMessageOnCrash(*msg);
+		// freeing it isn't safe here, the process is going away anyway
+		msg.release();
+	}
+}
+
+void CLogManager::WriteFlightRecordsOnCrash(CModule &module,
+	std::chrono::system_clock::time_point until)
+{
+	module.flight_recorder->TakeUntil(until, [&](CFlightRecorder::Record const &record)
+	{
+		char text[CFlightRecorder::MaxTextLength + 32];
+		sigsafe::CWriter writer(text, sizeof(text));
+		writer.Append(FlightRecordMarker).Append(record.text, record.text_length);
+		WriteLineOnCrash(m_CrashModuleFds[module.id], module.file_path.c_str(),
+			record.timestamp, record.level, nullptr, writer.GetData(), writer.GetLength(),
+			&record.call_info, record.call_info.file != nullptr ? 1 : 0);
+	});
+}
 
-			if (loglevel_file != nullptr)
+void CLogManager::WriteMessageOnCrash(CMessage const &msg)
+{
+	CModule *module = CModuleRegistry::Get()->GetModule(msg.log_module);
+	if (module == nullptr)
+		return;
+
+	const char *text = msg.GetText();
+	size_t text_length = msg.GetTextLength();
+	char native_call_text[256];
+	if (msg.type == CMessage::Type::NATIVE_CALL)
+	{
+		// formatting it needs the AMX debug info and allocates
+		size_t name_length = 0;
+		const char *name = nativecall::GetName(msg, name_length);
+		sigsafe::CWriter writer(native_call_text, sizeof(native_call_text));
+		writer.Append("native call to '");
+		if (name != nullptr)
+			writer.Append(name, name_length);
+		writer.Append("' (parameters not formatted)");
+		text = writer.GetData();
+		text_length = writer.GetLength();
+	}
+
+	// binary logs would need a proper record, text is better than nothing
+	WriteLineOnCrash(m_CrashModuleFds[module->id], module->file_path.c_str(),
+		msg.timestamp, msg.loglevel, nullptr, text, text_length,
+		msg.GetCallInfo(), msg.GetCallInfoCount());
+
+	int *loglevel_fd = nullptr;
+	const char *loglevel_filepath = nullptr;
+	if (msg.loglevel & LogLevel::WARNING)
+	{
+		loglevel_fd = &m_CrashWarningFd;
+		loglevel_filepath = WarningLogPath;
+	}
+	else if (msg.loglevel & LogLevel::ERROR)
+	{
+		loglevel_fd = &m_CrashErrorFd;
+		loglevel_filepath = ErrorLogPath;
+	}
+	if (loglevel_fd != nullptr)
+	{
+		WriteLineOnCrash(*loglevel_fd, loglevel_filepath,
+			msg.timestamp, msg.loglevel, module->prefix.c_str(), text, text_length,
+			msg.GetCallInfo(), msg.GetCallInfoCount());
+	}
+}
+
+void CLogManager::WriteLineOnCrash(int &fd, const char *filepath,
+	std::chrono::system_clock::time_point timestamp, LogLevel level, const char *prefix,
+	const char *text, size_t text_length,
+	AmxFuncCallInfo const *call_info, size_t call_info_count)
+{
+	// open(2) is async-signal-safe, unlike fopen
+	if (fd < 0)
+	{
+		fd = open(filepath, O_RDWR | O_APPEND | O_CREAT, 0644);
+#ifdef LOGCORE_MMAP
+		// memory mapped log files end in zeroed, preallocated space; the
+		// lines have to go right after the actual data, not behind that space
+		struct stat st;
+		if (fd >= 0 && fstat(fd, &st) == 0 && st.st_size > 0)
+		{
+			const off_t data_end = static_cast<off_t>(
+				CMappedFile::FindDataEnd(fd, static_cast<size_t>(st.st_size)));
+			if (data_end != st.st_size)
 			{
-				(*loglevel_file) <<
-					"[" << timestamp << "] " <<
-					"[" << modulename << "] " <<
-					log_string.str() << '\n' << std::flush;
+				fcntl(fd, F_SETFL, 0); // no O_APPEND
+				lseek(fd, data_end, SEEK_SET);
 			}
+		}
+#endif
+	}
+	if (fd < 0)
+		return;
+
+	// same layout as the regular lines, only the timestamp differs
+	sigsafe::CWriter line(m_CrashBuffer, CrashBufferSize, fd);
+	line.Append("[").AppendTime(timestamp).Append("] ");
+	if (prefix != nullptr)
+		line.Append(prefix);
+	else
+		line.Append("[").Append(GetLogLevelName(level)).Append("] ");
+
+	line.Append(text, text_length);
+	if (call_info_count != 0)
+	{
+		line.Append(" (");
+		for (size_t i = 0; i != call_info_count; ++i)
+		{
+			if (i != 0)
+				line.Append(" -> ");
+			line.Append(call_info[i].file).Append(":").AppendNumber(call_info[i].line);
+		}
+		line.Append(")");
+	}
+	line.Append("\n");
+}
+#endif
+
+void CLogManager::WriteMessage(Writer &writer, Message_t const &msg, bool recorded /*= false*/)
+{
+	if (msg->type == CMessage::Type::NATIVE_CALL)
+	{
+		WriteMessage(writer, nativecall::Format(m_MessagePool, *msg));
+		return;
+	}
+
+	CModule *module = CModuleRegistry::Get()->GetModule(msg->log_module);
+	if (module == nullptr)
+		return;
+
+	// the suppressed messages leading up to an error come first
+	if (!recorded && module->flight_recorder
+		&& (msg->loglevel & (LogLevel::ERROR | LogLevel::FATAL)))
+	{
+		WriteFlightRecords(writer, *module, msg->timestamp);
+	}
+
+	const bool flush_now = (msg->loglevel & m_ImmediateFlushLevels) != 0;
 
-			//lock the log message queue again (because while-condition and cv.wait)
-			lk.lock();
+	// the files themselves might get replaced on rotation;
+	// recorded messages only go to the module log
+	LogFile_t *loglevel_file = nullptr;
+	if (!recorded && (msg->loglevel & LogLevel::WARNING))
+		loglevel_file = &m_WarningLog;
+	else if (!recorded && (msg->loglevel & LogLevel::ERROR))
+		loglevel_file = &m_ErrorLog;
+
+	if (m_OutputFormat == OutputFormat::BINARY)
+	{
+		const size_t length = WriteBinaryRecord(writer, *module, msg, flush_now);
+		RecordWrite(*module, *msg, length, recorded);
+		// warnings.log and errors.log stay readable
+		if (loglevel_file == nullptr)
+			return;
+	}
+
+	const std::string &timestamp = writer.timestamp.Format(msg->timestamp);
+
+	// build log string
+	fmt::MemoryWriter log_string;
+
+	log_string << msg->GetText();
+	if (msg->GetCallInfoCount() != 0)
+	{
+		log_string << " (";
+		for (size_t i = 0; i != msg->GetCallInfoCount(); ++i)
+		{
+			AmxFuncCallInfo const &ci = msg->GetCallInfo()[i];
+			if (i != 0)
+				log_string << " -> ";
+			log_string << ci.file << ":" << ci.line;
 		}
-	} while (m_ThreadRunning);
+		log_string << ")";
+	}
+
+	//default logging
+	if (m_OutputFormat == OutputFormat::TEXT)
+	{
+		CLogFile &logfile = GetModuleLogFile(writer, *module, module->file_path);
+		const std::string line = fmt::format("[{}] [{}] {}\n",
+			timestamp, GetLogLevelName(msg->loglevel), log_string.str());
+		logfile.Write(line);
+		if (flush_now)
+			logfile.Flush();
+		RecordWrite(*module, *msg, line.length(), recorded);
+	}
+
+
+	//per-log-level logging
+	if (loglevel_file != nullptr)
+	{
+		const std::string line = fmt::format("[{}] {}{}\n",
+			timestamp, module->prefix, log_string.str());
+
+		std::lock_guard<std::mutex> lg(m_LevelLogMtx);
+		RotateLevelLogIfNeeded(*loglevel_file);
+		(*loglevel_file)->Write(line);
+		m_LevelLogStats.bytes_written.fetch_add(line.length(), std::memory_order_relaxed);
+		if (flush_now)
+			(*loglevel_file)->Flush();
+	}
 }
 
-void CLogManager::CreateFolder(std::string foldername)
+void CLogManager::WriteFlightRecords(Writer &writer, CModule &module,
+	std::chrono::system_clock::time_point until)
 {
-#ifdef WIN32
-	std::replace(foldername.begin(), foldername.end(), '/', '\\');
-	CreateDirectoryA(foldername.c_str(), NULL);
-#else
-	std::replace(foldername.begin(), foldername.end(), '\\', '/');
-	mkdir(foldername.c_str(), ACCESSPERMS);
-#endif
+	module.flight_recorder->TakeUntil(until, [&](CFlightRecorder::Record const &record)
+	{
+		fmt::MemoryWriter text;
+		text << FlightRecordMarker << fmt::StringRef(record.text, record.text_length);
+		const size_t call_info_count = record.call_info.file != nullptr ? 1 : 0;
+		WriteMessage(writer, CMessage::Create(m_MessagePool, record.timestamp, module.id,
+			record.level, text.data(), text.size(), &record.call_info, call_info_count), true);
+	});
 }
 
+void CLogManager::RecordWrite(CModule &module, CMessage const &msg, size_t length,
+	bool recorded)
+{
+	module.stats.messages_written.fetch_add(1, std::memory_order_relaxed);
+	module.stats.bytes_written.fetch_add(length, std::memory_order_relaxed);
+	if (!recorded)
+	{
+		module.stats.buffer_latency.Add(std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::system_clock::now() - msg.timestamp));
+	}
+}
+
+CLogFile &CLogManager::GetModuleLogFile(Writer &writer, CModule &module,
+	string const &filepath)
+{
+	CLogFile *logfile = writer.log_files.Find(module.id);
+	if (logfile == nullptr)
+	{
+		logfile = &writer.log_files.Open(module.id, filepath);
+		logfile->SetFlushCounter(&module.stats.flushes);
+	}
+
+	if (m_Rotator.IsEnabled() && m_Rotator.NeedsRotation(*logfile))
+	{
+		writer.log_files.Close(module.id);
+		m_Rotator.Rotate(filepath);
+		logfile = &writer.log_files.Open(module.id, filepath);
+		logfile->SetFlushCounter(&module.stats.flushes);
+	}
+	return *logfile;
+}
+
+void CLogManager::RotateLevelLogIfNeeded(LogFile_t &logfile)
+{
+	if (!m_Rotator.IsEnabled() || !m_Rotator.NeedsRotation(*logfile))
+		return;
+
+	const string filepath = logfile->GetPath();
+	logfile.reset();
+	m_Rotator.Rotate(filepath);
+	logfile.reset(new CLogFile(filepath, true, m_LevelLogBufferSize,
+		m_LevelLogAsyncWriter, m_LevelLogSegmentSize));
+	logfile->SetFlushCounter(&m_LevelLogStats.flushes);
+}
+
+size_t CLogManager::WriteBinaryRecord(Writer &writer, CModule &module,
+	Message_t const &msg, bool flush_now)
+{
+	std::string &record = writer.record_buffer;
+	record.clear();
+
+	CLogFile *logfile = &GetModuleLogFile(writer, module, module.binary_file_path);
+	// every new (or freshly rotated) file starts with a header
+	if (logfile->GetSize() == 0)
+		binlog::AppendFileHeader(record, module.name);
+
+	const size_t offset = binlog::BeginRecord(record, msg->timestamp, module.id,
+		msg->loglevel, msg->GetText(), msg->GetTextLength(), msg->GetCallInfoCount());
+	for (size_t i = 0; i != msg->GetCallInfoCount(); ++i)
+		binlog::AppendCallInfo(record, msg->GetCallInfo()[i].line, msg->GetCallInfo()[i].file);
+	binlog::FinishRecord(record, offset);
+
+	logfile->Write(record);
+	if (flush_now)
+		logfile->Flush();
+	return record.length();
+}
 
 void samplog_Init()
 {
@@ -195,25 +1285,92 @@ void samplog_Exit()
 bool samplog_LogMessage(const char *module, LogLevel level, const char *msg,
 	samplog_AmxFuncCallInfo const *call_info /*= NULL*/, unsigned int call_info_size /*= 0*/)
 {
-	if (module == nullptr || strlen(module) == 0)
+	return samplog_LogModuleMessage(CModuleRegistry::Get()->Register(module),
+		level, msg, call_info, call_info_size);
+}
+
+bool samplog_LogModuleMessage(unsigned int module_id, LogLevel level, const char *msg,
+	samplog_AmxFuncCallInfo const *call_info /*= NULL*/, unsigned int call_info_size /*= 0*/)
+{
+	CModule *module = CModuleRegistry::Get()->GetModule(module_id);
+	if (module == nullptr)
 		return false;
 
-	std::vector<AmxFuncCallInfo> my_call_info;
-	if (call_info != nullptr && call_info_size != 0)
+	if (msg == nullptr)
+		msg = "";
+
+	// reject disabled messages before doing any work
+	if (!module->IsLogLevel(level))
 	{
-		for (unsigned int i = 0; i != call_info_size; ++i)
-			my_call_info.push_back(call_info[i]);
+		// but keep them around in case an error follows
+		if (module->flight_recorder)
+		{
+			module->flight_recorder->Add(level, msg, strlen(msg),
+				call_info, call_info_size);
+		}
+		return false;
 	}
 
-	CLogManager::Get()->QueueLogMessage(std::unique_ptr<CMessage>(new CMessage(
-		module, level, msg ? msg : "", std::move(my_call_info))));
+	// over-budget messages are only counted, also before doing any work
+	if (!module->CheckRateLimit(level))
+		return false;
+
+	// the last plugin might unload at the same time
+	CLogManager::UseGuard manager;
+	manager->QueueLogMessage(module_id, level,
+		msg, strlen(msg), call_info, call_info_size);
+	return true;
+}
+
+bool samplog_RecordModuleMessage(unsigned int module_id, LogLevel level, const char *msg,
+	samplog_AmxFuncCallInfo const *call_info /*= NULL*/, unsigned int call_info_size /*= 0*/)
+{
+	CModule *module = CModuleRegistry::Get()->GetModule(module_id);
+	if (module == nullptr || !module->flight_recorder)
+		return false;
+
+	if (msg == nullptr)
+		msg = "";
+
+	module->flight_recorder->Add(level, msg, strlen(msg), call_info, call_info_size);
 	return true;
 }
 
+bool samplog_GetStats(unsigned int module_id, samplog_Stats *stats)
+{
+	// callers built against an older header pass a smaller struct
+	if (stats == nullptr || stats->size < sizeof(stats->size))
+		return false;
+
+	samplog_Stats all_stats;
+	CLogManager::UseGuard manager;
+	if (!manager->GetStats(module_id, all_stats))
+		return false;
+
+	const unsigned int size = stats->size;
+	all_stats.size = std::min<unsigned int>(size, sizeof(samplog_Stats));
+	std::memcpy(stats, &all_stats, all_stats.size);
+	return true;
+}
+
+bool samplog_Flush(unsigned int timeout_ms, bool sync)
+{
+	CLogManager::UseGuard manager;
+	return manager->Flush(std::chrono::milliseconds(timeout_ms), sync);
+}
+
 bool samplog_LogNativeCall(const char *module,
 	AMX * const amx, cell * const params, const char *name, const char *params_format)
 {
-	if (module == nullptr || strlen(module) == 0)
+	CModuleRegistry *registry = CModuleRegistry::Get();
+	const ModuleId module_id = registry->Register(module);
+	if (module_id == InvalidModuleId)
+		return false;
+
+	// native calls are logged as debug messages, skip formatting
+	// and the call trace walk if those are disabled
+	CModule *log_module = registry->GetModule(module_id);
+	if (!log_module->IsLogLevel(LogLevel::DEBUG))
 		return false;
 
 	if (amx == nullptr)
@@ -228,60 +1385,9 @@ bool samplog_LogNativeCall(const char *module,
 	if (params_format == nullptr) // params_format == "" is valid (no parameters)
 		return false;
 
+	if (!log_module->CheckRateLimit(LogLevel::DEBUG))
+		return false;
 
-	size_t format_len = strlen(params_format);
-
-	fmt::MemoryWriter fmt_msg;
-	fmt_msg << name << '(';
-
-	for (int i = 0; i != format_len; ++i)
-	{
-		if (i != 0)
-			fmt_msg << ", ";
-
-		cell current_param = params[i + 1];
-		switch (params_format[i])
-		{
-		case 'd': //decimal
-		case 'i': //integer
-			fmt_msg << static_cast<int>(current_param);
-			break;
-		case 'f': //float
-			fmt_msg << amx_ctof(current_param);
-			break;
-		case 'h': //hexadecimal
-		case 'x': //
-			fmt_msg << fmt::hex(current_param);
-			break;
-		case 'b': //binary
-			fmt_msg << fmt::bin(current_param);
-			break;
-		case 's': //string
-			fmt_msg << '"' << amx_GetCppString(amx, current_param) << '"';
-			break;
-		case '*': //censored output
-			fmt_msg << "\"*****\"";
-			break;
-		case 'r': //reference
-		{
-			cell *addr_dest = nullptr;
-			amx_GetAddr(amx, current_param, &addr_dest);
-			fmt_msg << "0x" << fmt::pad(fmt::hexu(reinterpret_cast<unsigned int>(addr_dest)), 8, '0');
-		}	break;
-		case 'p': //pointer-value
-			fmt_msg << "0x" << fmt::pad(fmt::hexu(current_param), 8, '0');
-			break;
-		default:
-			return false; //unrecognized format specifier
-		}
-	}
-	fmt_msg << ')';
-
-	std::vector<AmxFuncCallInfo> call_info;
-	CAmxDebugManager::Get()->GetFunctionCallTrace(amx, call_info);
-
-	CLogManager::Get()->QueueLogMessage(std::unique_ptr<CMessage>(new CMessage(
-		module, LogLevel::DEBUG, fmt_msg.str(), std::move(call_info))));
-
-	return true;
+	CLogManager::UseGuard manager;
+	return manager->QueueNativeCall(module_id, amx, params, name, params_format);
 }
@@ -4,20 +4,59 @@
 #include <memory>
 #include <string>
 #include <thread>
-#include <queue>
 #include <mutex>
 #include <map>
+#include <vector>
 #include <condition_variable>
 #include <functional>
-#include <fstream>
+#include <chrono>
+#include <limits>
 
 #include "CSingleton.hpp"
+#include "CRingBuffer.hpp"
+#include "CLogFile.hpp"
+#include "CLogRotator.hpp"
+#include "CDuplicateFilter.hpp"
+#include "CTimestampFormatter.hpp"
+#ifdef LOGCORE_IO_URING
+#  include "CIoUringWriter.hpp"
+#endif
 #include "loglevel.hpp"
 #include "CMessage.hpp"
+#include "CMessagePool.hpp"
 #include "CAmxDebugManager.hpp"
+#include "CModuleRegistry.hpp"
 #include "export.h"
 
 
+enum class OverflowPolicy
+{
+	BLOCK, // wait for the writer thread, drop the message after a timeout
+	DROP_NEWEST,
+	DROP_OLDEST,
+	DROP_BELOW_WARNING, // drop debug/info messages, block for everything else
+};
+
+enum class OutputFormat
+{
+	TEXT,
+	BINARY, // module logs only, see binlog.hpp
+};
+
+// message queues of a single producer thread, one for every writer thread;
+// only the owning thread pushes into them
+struct CProducerQueue
+{
+	CProducerQueue(size_t writer_count, size_t capacity)
+	{
+		for (size_t i = 0; i != writer_count; ++i)
+			queues.emplace_back(new CRingBuffer<Message_t>(capacity));
+	}
+
+	std::vector<std::unique_ptr<CRingBuffer<Message_t>>> queues;
+	std::atomic<bool> in_use{ true }; // false once the owning thread exited
+};
+
 class CLogManager : public CSingleton<CLogManager>
 {
 	friend class CSingleton<CLogManager>;
@@ -34,32 +73,222 @@ public:
 	}
 	inline void DecreasePluginCounter()
 	{
+		// waits for other threads which are still logging
 		if (--m_PluginCounter == 0) //last plugin
 			CSingleton::Destroy();
 	}
+	// module of log-core's own messages, "logs/log-core.log"
+	inline ModuleId GetLogCoreModule() const
+	{
+		return m_LogCoreModule;
+	}
+	void QueueLogMessage(ModuleId module, LogLevel level,
+		const char *text, size_t text_length,
+		AmxFuncCallInfo const *call_info = nullptr, size_t call_info_count = 0);
 	void QueueLogMessage(Message_t &&msg);
+	// returns false if the parameter format is invalid
+	bool QueueNativeCall(ModuleId module, AMX * const amx,
+		cell * const params, const char *name, const char *params_format);
+
+	// 'module' InvalidModuleId gets the stats of all modules together
+	bool GetStats(ModuleId module, samplog_Stats &dest) const;
+	// waits until every message queued before the call is written, 'sync'
+	// also waits until it's on the disk; returns false on timeout
+	bool Flush(std::chrono::milliseconds timeout, bool sync);
+#if !(defined(WIN32) || defined(_WIN32) || defined(__WIN32__))
+	// async-signal-safe, used by the crash handler: gives the writer threads
+	// a moment to write out what they have, then writes the messages still
+	// waiting in the queues and 'reason' straight to the log files
+	void WriteOutOnCrash(const char *reason, size_t reason_length);
+#endif
 
 private:
-	void Process();
-	void CreateFolder(std::string foldername);
+	// messages taken out of a single queue, range in the drained batch
+	struct DrainRun
+	{
+		size_t begin, end;
+	};
+
+	// a writer thread writes the log files of every module with
+	// (module ID % writer count) == index, so the messages of a module
+	// always go through the same thread
+	struct Writer
+	{
+		Writer(size_t idx, size_t queue_capacity, size_t max_open_files,
+			CLogFile::Clock::duration idle_timeout, size_t file_buffer_size,
+			string const &timestamp_format, std::chrono::milliseconds duplicate_window) :
+			index(idx),
+			shared_queue(queue_capacity),
+			log_files(max_open_files, idle_timeout, file_buffer_size),
+			timestamp(timestamp_format),
+			duplicates(duplicate_window)
+		{ }
+
+		const size_t index;
+		// used by producer threads without a queue of their own
+		CRingBuffer<Message_t> shared_queue;
+#ifdef LOGCORE_IO_URING
+		// has to outlive all log files
+		std::unique_ptr<CIoUringWriter> async_writer;
+#endif
+		CLogFileCache log_files;
+		CTimestampFormatter timestamp;
+		std::string record_buffer; // for binary records
+		CDuplicateFilter duplicates;
+		// see DrainQueues
+		std::vector<DrainRun> drain_runs;
+		std::vector<Message_t> merge_buffer;
+		int64_t drain_start = std::numeric_limits<int64_t>::min();
+
+		// messages waiting in the queues when they were last drained
+		std::atomic<size_t>
+			queue_depth{ 0 },
+			queue_high_water{ 0 };
+		std::thread thread;
+
+		// only used to put the writer thread to sleep when there's nothing to do,
+		// producers just lock it if the writer is actually sleeping
+		std::mutex sleep_mtx;
+		std::condition_variable notifier;
+		std::atomic<bool> sleeping{ false };
+
+		// see CLogManager::Flush
+		std::atomic<unsigned int>
+			flush_requests{ 0 },
+			flush_waiters{ 0 },
+			sync_waiters{ 0 };
+		unsigned int handled_flush_requests = 0; // only used by the writer thread
+
+		// set once everything got written out after a crash
+		std::atomic<bool> crash_flushed{ false };
+	};
+
+	inline Writer &GetWriter(ModuleId module)
+	{
+		return *m_Writers[module % m_Writers.size()];
+	}
+
+	CRingBuffer<Message_t> &GetProducerQueue(Writer &writer);
+	std::shared_ptr<CProducerQueue> ClaimProducerQueue();
+	// returns true if the message could be queued after all
+	bool HandleQueueOverflow(CRingBuffer<Message_t> &queue, Message_t &msg);
+	void CountDroppedMessage(ModuleId module);
+
+	// takes the messages out of the writer's queues in chronological order;
+	// 'saturated' is set if a queue has more than a batch waiting
+	size_t DrainQueues(Writer &writer, std::vector<Message_t> &dest, bool &saturated);
+	bool AreQueuesEmpty(Writer const &writer) const;
+	void Process(Writer &writer);
+	// 'recorded' messages come from a flight recorder, they only go to the module log
+	void WriteMessage(Writer &writer, Message_t const &msg, bool recorded = false);
+	// writes the flight recorder entries of 'module' up to 'until'
+	void WriteFlightRecords(Writer &writer, CModule &module,
+		std::chrono::system_clock::time_point until);
+	// opens the log file of 'module', rotates it first if necessary
+	CLogFile &GetModuleLogFile(Writer &writer, CModule &module, string const &filepath);
+	// 'm_LevelLogMtx' has to be locked
+	void RotateLevelLogIfNeeded(LogFile_t &logfile);
+	// updates the stats of 'module' after 'msg' got written; 'recorded' messages
+	// were held back on purpose, their age says nothing about the latency
+	void RecordWrite(CModule &module, CMessage const &msg, size_t length, bool recorded);
+	// returns the size of the record
+	size_t WriteBinaryRecord(Writer &writer, CModule &module,
+		Message_t const &msg, bool flush_now);
+	// returns false if 'msg' is a repeated message which shouldn't be written
+	bool CheckDuplicate(Writer &writer, Message_t const &msg);
+	void WriteRepeatSummary(Writer &writer, CDuplicateFilter::Entry const &entry);
+	void WriteDroppedMessagesSummary(Writer &writer);
+	void WriteRateLimitSummary(Writer &writer);
+	void WriteModuleLimitError(Writer &writer);
+	void WriteStats(Writer &writer);
+	void FlushAll(Writer &writer);
+	// flushes all files and waits until the data got written, then
+	// marks everything taken out of the queues so far as processed
+	void SyncAll(Writer &writer, bool to_disk);
+#if !(defined(WIN32) || defined(_WIN32) || defined(__WIN32__))
+	// these only use the pre-allocated crash buffer and never free a message
+	void DrainQueueOnCrash(CRingBuffer<Message_t> &queue);
+	void WriteMessageOnCrash(CMessage const &msg);
+	void WriteFlightRecordsOnCrash(CModule &module,
+		std::chrono::system_clock::time_point until);
+	// 'prefix' replaces the log level, like in warnings.log and errors.log
+	void WriteLineOnCrash(int &fd, const char *filepath,
+		std::chrono::system_clock::time_point timestamp, LogLevel level, const char *prefix,
+		const char *text, size_t text_length,
+		AmxFuncCallInfo const *call_info, size_t call_info_count);
+#endif
 
 private:
-	std::ofstream
+	CLogRotator m_Rotator;
+
+	std::vector<std::unique_ptr<Writer>> m_Writers;
+
+	// warnings.log and errors.log collect messages from all writer threads;
+	// the lock keeps lines whole, their order is only chronological per module
+	std::mutex m_LevelLogMtx;
+	LogFile_t
 		m_WarningLog,
 		m_ErrorLog;
+	CModuleStats m_LevelLogStats; // only bytes written and flushes
+	// needed to reopen them after a rotation
+	size_t m_LevelLogBufferSize = 0;
+	CIoUringWriter *m_LevelLogAsyncWriter = nullptr;
+	size_t m_LevelLogSegmentSize = 0;
+
+	OutputFormat m_OutputFormat = OutputFormat::TEXT;
+	// format native calls on the writer thread instead of the calling thread
+	bool m_DeferNativeCalls = true;
+
+	// flush policy
+	std::chrono::milliseconds m_FlushInterval;
+	int m_ImmediateFlushLevels;
 
 	std::atomic<bool> m_ThreadRunning;
-	std::thread *m_Thread = nullptr;
 
-	std::mutex m_QueueMtx;
-	std::condition_variable m_QueueNotifier;
-	std::queue<Message_t> m_LogMsgQueue;
+	CMessagePool m_MessagePool;
+
+	// every producer thread gets its own queues, so producers never contend
+	// with each other; threads beyond the limit share the writers' queues
+	static const size_t MaxProducerQueues = 64;
+	const unsigned int m_Generation; // tells thread-local queue handles apart from older instances
+	const size_t m_QueueCapacity;
+	// shared with the thread-local handles, see ProducerQueueHandle
+	std::shared_ptr<CProducerQueue> m_ProducerQueues[MaxProducerQueues];
+	std::atomic<size_t> m_ProducerQueueCount{ 0 };
+	std::mutex m_ProducerQueueMtx; // only locked to claim a queue
+
+	// blocking would stall the server's main thread if the disk stalls
+	OverflowPolicy m_OverflowPolicy = OverflowPolicy::DROP_NEWEST;
+	std::chrono::milliseconds m_BlockTimeout;
+	std::atomic<unsigned int> m_DroppedMessages{ 0 }; // since the last summary
+
+	// writer thread batch statistics
+	std::atomic<unsigned long long>
+		m_BatchCount{ 0 },
+		m_BatchedMessageCount{ 0 };
+	std::atomic<size_t> m_MaxBatchSize{ 0 };
 
-	std::string m_DateTimeFormat;
+	// Flush waits for the writer threads with this
+	std::mutex m_FlushMtx;
+	std::condition_variable m_FlushNotifier;
+
+	// a stats line is written to the log-core log this often, '0' disables it
+	std::chrono::seconds m_StatsInterval;
 
 	std::atomic<int> m_PluginCounter{ 0 };
-};
 
+	// see WriteOutOnCrash
+	std::atomic<bool> m_Crashed{ false };
+	const ModuleId m_LogCoreModule;
+#if !(defined(WIN32) || defined(_WIN32) || defined(__WIN32__))
+	static const size_t CrashBufferSize = 16384;
+	char m_CrashBuffer[CrashBufferSize];
+	// opened by the crash handler on first use, '-1' if not opened (yet)
+	int m_CrashModuleFds[CModuleRegistry::MaxModules + 1];
+	int m_CrashWarningFd = -1;
+	int m_CrashErrorFd = -1;
+#endif
+};
 
 extern "C" DLL_PUBLIC void samplog_Init();
 extern "C" DLL_PUBLIC void samplog_Exit();
@@ -67,6 +296,16 @@ extern "C" DLL_PUBLIC bool samplog_LogMessage(
 	const char *module, LogLevel level, const char *msg,
 	samplog_AmxFuncCallInfo const *call_info = NULL, 
 	unsigned int call_info_size = 0);
+extern "C" DLL_PUBLIC bool samplog_LogModuleMessage(
+	unsigned int module_id, LogLevel level, const char *msg,
+	samplog_AmxFuncCallInfo const *call_info = NULL,
+	unsigned int call_info_size = 0);
 extern "C" DLL_PUBLIC bool samplog_LogNativeCall(
 	const char *module, AMX * const amx, cell * const params,
 	const char *name, const char *params_format);
+extern "C" DLL_PUBLIC bool samplog_RecordModuleMessage(
+	unsigned int module_id, LogLevel level, const char *msg,
+	samplog_AmxFuncCallInfo const *call_info = NULL,
+	unsigned int call_info_size = 0);
+extern "C" DLL_PUBLIC bool samplog_GetStats(unsigned int module_id, samplog_Stats *stats);
+extern "C" DLL_PUBLIC bool samplog_Flush(unsigned int timeout_ms, bool sync);
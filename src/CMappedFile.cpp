@@ -0,0 +1,179 @@
+#include "CMappedFile.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+namespace
+{
+	bool Preallocate(int fd, size_t offset, size_t length)
+	{
+#ifdef __APPLE__
+		struct stat st;
+		if (fstat(fd, &st) != 0)
+			return false;
+		if (static_cast<size_t>(st.st_size) >= offset + length)
+			return true;
+
+		// ftruncate alone doesn't reserve any blocks, writing to the mapping
+		// would raise SIGBUS instead of failing here if the disk is full
+		fstore_t store = { F_ALLOCATECONTIG | F_ALLOCATEALL, F_PEOFPOSMODE, 0,
+			static_cast<off_t>(offset + length - st.st_size), 0 };
+		if (fcntl(fd, F_PREALLOCATE, &store) == -1)
+		{
+			store.fst_flags = F_ALLOCATEALL;
+			if (fcntl(fd, F_PREALLOCATE, &store) == -1)
+				return false;
+		}
+		return ftruncate(fd, offset + length) == 0;
+#else
+		return posix_fallocate(fd, offset, length) == 0;
+#endif
+	}
+}
+
+
+std::unique_ptr<CMappedFile> CMappedFile::Open(string const &filepath,
+	bool append, size_t segment_size)
+{
+	const long page_size = sysconf(_SC_PAGESIZE);
+	if (page_size <= 0 || segment_size == 0)
+		return nullptr;
+
+	const int fd = open(filepath.c_str(),
+		O_RDWR | O_CREAT | O_CLOEXEC | (append ? 0 : O_TRUNC), 0644);
+	if (fd < 0)
+		return nullptr;
+
+	size_t size = 0;
+	struct stat st;
+	if (append && fstat(fd, &st) == 0)
+		size = FindDataEnd(fd, static_cast<size_t>(st.st_size));
+
+	const size_t page = static_cast<size_t>(page_size);
+	segment_size = (segment_size + page - 1) / page * page;
+
+	std::unique_ptr<CMappedFile> file(new CMappedFile(fd, size, segment_size, page));
+	if (!file->MapSegment(size))
+		return nullptr;
+	return file;
+}
+
+size_t CMappedFile::FindDataEnd(int fd, size_t file_size)
+{
+	char buffer[4096];
+	size_t end = file_size;
+	while (end != 0)
+	{
+		const size_t chunk = std::min(end, sizeof(buffer));
+		if (pread(fd, buffer, chunk, end - chunk) != static_cast<ssize_t>(chunk))
+			return file_size;
+
+		for (size_t i = chunk; i != 0; --i)
+		{
+			if (buffer[i - 1] != '\0')
+				return end - chunk + i;
+		}
+		end -= chunk;
+	}
+	return 0;
+}
+
+CMappedFile::CMappedFile(int fd, size_t size, size_t segment_size, size_t page_size) :
+	m_Fd(fd),
+	m_Size(size),
+	m_SegmentSize(segment_size),
+	m_PageSize(page_size)
+{ }
+
+CMappedFile::~CMappedFile()
+{
+	Unmap();
+	// remove the preallocated space which wasn't used; a file which got
+	// truncated by someone else is already shorter than that
+	if (!m_Truncated && ftruncate(m_Fd, m_Size) != 0)
+	{
+		// nothing we can do, the zeroed space gets skipped on the next start
+	}
+	close(m_Fd);
+}
+
+void CMappedFile::Sync()
+{
+	// pages of already unmapped segments are written back by fdatasync
+	if (m_Window != nullptr)
+		msync(m_Window, m_WindowSize, MS_SYNC);
+#ifdef __APPLE__
+	fsync(m_Fd);
+#else
+	fdatasync(m_Fd);
+#endif
+}
+
+bool CMappedFile::Write(const char *data, size_t length)
+{
+	while (length != 0)
+	{
+		const size_t window_end = m_WindowOffset + m_WindowSize;
+		if (m_Window == nullptr || m_Size == window_end)
+		{
+			// move on to the next segment
+			if (!MapSegment(m_Size))
+				return false;
+			continue;
+		}
+
+		const size_t chunk = std::min(length, window_end - m_Size);
+		std::memcpy(m_Window + (m_Size - m_WindowOffset), data, chunk);
+		m_Size += chunk;
+		data += chunk;
+		length -= chunk;
+	}
+	return true;
+}
+
+bool CMappedFile::MapSegment(size_t offset)
+{
+	// the file was preallocated up to the end of the current window, if it's
+	// shorter now it was truncated and the next write could raise SIGBUS
+	struct stat st;
+	if (m_Window != nullptr && (fstat(m_Fd, &st) != 0
+		|| static_cast<size_t>(st.st_size) < m_WindowOffset + m_WindowSize))
+	{
+		m_Truncated = true;
+		Unmap();
+		return false;
+	}
+
+	Unmap();
+
+	// mappings have to start on a page boundary
+	const size_t window_offset = offset - (offset % m_PageSize);
+	if (!Preallocate(m_Fd, window_offset, m_SegmentSize))
+		return false;
+
+	void *window = mmap(nullptr, m_SegmentSize, PROT_READ | PROT_WRITE,
+		MAP_SHARED, m_Fd, static_cast<off_t>(window_offset));
+	if (window == MAP_FAILED)
+		return false;
+
+	m_Window = static_cast<char *>(window);
+	m_WindowOffset = window_offset;
+	m_WindowSize = m_SegmentSize;
+	return true;
+}
+
+void CMappedFile::Unmap()
+{
+	if (m_Window == nullptr)
+		return;
+
+	munmap(m_Window, m_WindowSize);
+	m_Window = nullptr;
+	m_WindowSize = 0;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+using std::string;
+
+
+// append-only file written through a memory mapped window; the file grows
+// in preallocated segments, so appending is a plain memory copy most of the
+// time and the kernel writes the pages back in the background
+class CMappedFile
+{
+public:
+	// returns nullptr if the file can't be opened or mapped;
+	// 'segment_size' gets rounded up to a multiple of the page size
+	static std::unique_ptr<CMappedFile> Open(string const &filepath,
+		bool append, size_t segment_size);
+	// trims the file to the size of the actually written data
+	~CMappedFile();
+	CMappedFile(const CMappedFile &rhs) = delete;
+	CMappedFile &operator=(const CMappedFile &rhs) = delete;
+
+private:
+	CMappedFile(int fd, size_t size, size_t segment_size, size_t page_size);
+
+public:
+	// returns false if the file couldn't grow or was truncated by someone
+	// else, the data up to GetSize() is written nevertheless
+	bool Write(const char *data, size_t length);
+	// waits until all written data is on the disk
+	void Sync();
+
+	inline size_t GetSize() const
+	{
+		return m_Size;
+	}
+
+	// preallocated but unused space is left zeroed if the process dies
+	// before trimming the file, finds the end of the actual data;
+	// async-signal-safe, 'fd' has to be readable
+	static size_t FindDataEnd(int fd, size_t file_size);
+
+private:
+	// preallocates and maps the segment containing 'offset'
+	bool MapSegment(size_t offset);
+	void Unmap();
+
+private:
+	const int m_Fd;
+	size_t m_Size; // amount of data actually written
+	bool m_Truncated = false;
+	const size_t
+		m_SegmentSize,
+		m_PageSize;
+
+	char *m_Window = nullptr;
+	size_t
+		m_WindowOffset = 0,
+		m_WindowSize = 0;
+};
@@ -0,0 +1,77 @@
+#include "CMessage.hpp"
+
+#include <cstring>
+#include <new>
+
+
+Message_t CMessage::Create(CMessagePool &pool,
+	ModuleId module, LogLevel level, const char *text, size_t text_length,
+	AmxFuncCallInfo const *call_info /*= nullptr*/, size_t call_info_count /*= 0*/)
+{
+	return Create(pool, Type::TEXT, std::chrono::system_clock::now(),
+		module, level, text, text_length, call_info, call_info_count);
+}
+
+Message_t CMessage::Create(CMessagePool &pool,
+	std::chrono::system_clock::time_point timestamp, ModuleId module, LogLevel level,
+	const char *text, size_t text_length,
+	AmxFuncCallInfo const *call_info /*= nullptr*/, size_t call_info_count /*= 0*/)
+{
+	return Create(pool, Type::TEXT, timestamp,
+		module, level, text, text_length, call_info, call_info_count);
+}
+
+Message_t CMessage::CreateNativeCall(CMessagePool &pool,
+	ModuleId module, LogLevel level, const char *data, size_t data_length)
+{
+	return Create(pool, Type::NATIVE_CALL, std::chrono::system_clock::now(),
+		module, level, data, data_length, nullptr, 0);
+}
+
+Message_t CMessage::Create(CMessagePool &pool, Type type,
+	std::chrono::system_clock::time_point timestamp, ModuleId module, LogLevel level,
+	const char *text, size_t text_length,
+	AmxFuncCallInfo const *call_info, size_t call_info_count)
+{
+	if (call_info == nullptr)
+		call_info_count = 0;
+
+	const size_t size = sizeof(CMessage)
+		+ sizeof(AmxFuncCallInfo) * call_info_count
+		+ text_length + 1;
+
+	CMessagePool *owner = &pool;
+	void *mem = pool.Allocate(size);
+	if (mem == nullptr)
+	{
+		owner = nullptr;
+		mem = ::operator new(size);
+	}
+
+	CMessage *msg = new (mem) CMessage(owner, type, timestamp,
+		module, level, text_length, call_info_count);
+
+	if (call_info_count != 0)
+	{
+		std::memcpy(const_cast<AmxFuncCallInfo *>(msg->GetCallInfo()),
+			call_info, sizeof(AmxFuncCallInfo) * call_info_count);
+	}
+
+	char *msg_text = const_cast<char *>(msg->GetText());
+	if (text_length != 0)
+		std::memcpy(msg_text, text, text_length);
+	msg_text[text_length] = '\0';
+
+	return Message_t(msg);
+}
+
+void CMessage::Deleter::operator()(CMessage *msg) const
+{
+	CMessagePool *pool = msg->m_Pool;
+	msg->~CMessage();
+
+	if (pool != nullptr)
+		pool->Free(msg);
+	else
+		::operator delete(msg);
+}
@@ -1,28 +1,60 @@
 #pragma once
 
-#include <string>
 #include <memory>
-#include <vector>
 #include <chrono>
-
-using std::string;
+#include <cstddef>
 
 #include "loglevel.hpp"
 #include "CAmxDebugManager.hpp"
+#include "CModuleRegistry.hpp"
+#include "CMessagePool.hpp"
 
 
+/*
+  A message is a single contiguous record: this header, followed by the
+  call info entries, followed by the (null-terminated) text. It's carved
+  out of a CMessagePool block if it fits, otherwise it's allocated on the heap.
+*/
 class CMessage
 {
 public:
-	CMessage(string module,
-		LogLevel level, string msg,
-		std::vector<AmxFuncCallInfo> &&info) :
+	enum class Type
+	{
+		TEXT,
+		NATIVE_CALL, // the text holds captured native call data, see nativecall.hpp
+	};
+
+	struct Deleter
+	{
+		void operator()(CMessage *msg) const;
+	};
+
+	static std::unique_ptr<CMessage, Deleter> Create(CMessagePool &pool,
+		ModuleId module, LogLevel level, const char *text, size_t text_length,
+		AmxFuncCallInfo const *call_info = nullptr, size_t call_info_count = 0);
+	static std::unique_ptr<CMessage, Deleter> Create(CMessagePool &pool,
+		std::chrono::system_clock::time_point timestamp, ModuleId module, LogLevel level,
+		const char *text, size_t text_length,
+		AmxFuncCallInfo const *call_info = nullptr, size_t call_info_count = 0);
+	static std::unique_ptr<CMessage, Deleter> CreateNativeCall(CMessagePool &pool,
+		ModuleId module, LogLevel level, const char *data, size_t data_length);
+
+private:
+	static std::unique_ptr<CMessage, Deleter> Create(CMessagePool &pool, Type type,
+		std::chrono::system_clock::time_point timestamp, ModuleId module, LogLevel level,
+		const char *text, size_t text_length,
+		AmxFuncCallInfo const *call_info, size_t call_info_count);
+
+	CMessage(CMessagePool *pool, Type type, std::chrono::system_clock::time_point time,
+		ModuleId module, LogLevel level, size_t text_length, size_t call_info_count) :
 
-		timestamp(std::chrono::system_clock::now()),
-		log_module(std::move(module)),
+		timestamp(time),
+		type(type),
 		loglevel(level),
-		text(std::move(msg)),
-		call_info(std::move(info))
+		log_module(module),
+		m_Pool(pool),
+		m_TextLength(text_length),
+		m_CallInfoCount(call_info_count)
 	{ }
 	~CMessage() = default;
 
@@ -33,14 +65,39 @@ public:
 	CMessage operator=(const CMessage &&rhs) = delete;
 
 public:
-	const string text;
-	const std::chrono::system_clock::time_point timestamp;
+	inline const char *GetText() const
+	{
+		return reinterpret_cast<const char *>(GetCallInfo() + m_CallInfoCount);
+	}
+	inline size_t GetTextLength() const
+	{
+		return m_TextLength;
+	}
+	inline AmxFuncCallInfo const *GetCallInfo() const
+	{
+		return reinterpret_cast<AmxFuncCallInfo const *>(this + 1);
+	}
+	inline size_t GetCallInfoCount() const
+	{
+		return m_CallInfoCount;
+	}
 
-	const std::vector<AmxFuncCallInfo> call_info;
+public:
+	const std::chrono::system_clock::time_point timestamp;
+	const Type type;
 
 	LogLevel const loglevel;
-	const string log_module;
+	const ModuleId log_module;
 
+private:
+	CMessagePool * const m_Pool; // nullptr if allocated on the heap
+	const size_t
+		m_TextLength,
+		m_CallInfoCount;
 };
 
-using Message_t = std::unique_ptr<CMessage>;
+// the call info entries directly follow the header
+static_assert(sizeof(CMessage) % alignof(AmxFuncCallInfo) == 0,
+	"CMessage header breaks call info alignment");
+
+using Message_t = std::unique_ptr<CMessage, CMessage::Deleter>;
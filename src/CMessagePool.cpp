@@ -0,0 +1,61 @@
+#include "CMessagePool.hpp"
+
+
+CMessagePool::CMessagePool(size_t block_size, size_t block_count) :
+	// keep every block aligned for the message header
+	m_BlockSize((block_size + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1)),
+	m_BlockCount(block_count)
+{
+	m_Arena = static_cast<unsigned char *>(::operator new(m_BlockSize * m_BlockCount));
+	m_NextFree = new std::atomic<uint32_t>[m_BlockCount];
+	for (size_t i = 0; i != m_BlockCount; ++i)
+		m_NextFree[i].store(static_cast<uint32_t>(i + 2 <= m_BlockCount ? i + 2 : 0),
+			std::memory_order_relaxed);
+	m_FreeHead.store(m_BlockCount != 0 ? 1 : 0);
+}
+
+CMessagePool::~CMessagePool()
+{
+	delete[] m_NextFree;
+	::operator delete(m_Arena);
+}
+
+void *CMessagePool::Allocate(size_t size)
+{
+	if (size > m_BlockSize)
+		return nullptr;
+
+	uint64_t head = m_FreeHead.load(std::memory_order_acquire);
+	while (true)
+	{
+		const uint32_t index = static_cast<uint32_t>(head);
+		if (index == 0)
+			return nullptr; // exhausted
+
+		const uint64_t next = m_NextFree[index - 1].load(std::memory_order_relaxed);
+		const uint64_t new_head = (((head >> 32) + 1) << 32) | next;
+		if (m_FreeHead.compare_exchange_weak(head, new_head,
+			std::memory_order_acquire, std::memory_order_acquire))
+		{
+			return m_Arena + (index - 1) * m_BlockSize;
+		}
+	}
+}
+
+void CMessagePool::Free(void *block)
+{
+	const uint32_t index = static_cast<uint32_t>(
+		(static_cast<unsigned char *>(block) - m_Arena) / m_BlockSize) + 1;
+
+	uint64_t head = m_FreeHead.load(std::memory_order_relaxed);
+	while (true)
+	{
+		m_NextFree[index - 1].store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+		const uint64_t new_head = (((head >> 32) + 1) << 32) | index;
+		if (m_FreeHead.compare_exchange_weak(head, new_head,
+			std::memory_order_release, std::memory_order_relaxed))
+		{
+			return;
+		}
+	}
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+
+// pre-allocated arena of fixed-size blocks for message records;
+// any thread can allocate, any thread can free, without locking
+class CMessagePool
+{
+public:
+	CMessagePool(size_t block_size, size_t block_count);
+	~CMessagePool();
+	CMessagePool(const CMessagePool &rhs) = delete;
+	CMessagePool &operator=(const CMessagePool &rhs) = delete;
+
+public:
+	// returns nullptr if 'size' doesn't fit into a block or the pool is exhausted
+	void *Allocate(size_t size);
+	void Free(void *block);
+
+	inline bool Owns(const void *ptr) const
+	{
+		const unsigned char *p = static_cast<const unsigned char *>(ptr);
+		return p >= m_Arena && p < m_Arena + m_BlockSize * m_BlockCount;
+	}
+
+private:
+	const size_t
+		m_BlockSize,
+		m_BlockCount;
+	unsigned char *m_Arena;
+
+	// free list of block indices (+1, 0 means end of list); the head
+	// carries a tag in its upper 32 bits against the ABA problem
+	std::atomic<uint32_t> *m_NextFree;
+	std::atomic<uint64_t> m_FreeHead;
+};
@@ -0,0 +1,259 @@
+#include "CModuleRegistry.hpp"
+#include "CSampConfigReader.hpp"
+#include "filesystem.hpp"
+
+#include <cstring>
+#include <cstdio>
+
+
+namespace
+{
+	// FNV-1a
+	size_t HashModuleName(const char *name)
+	{
+		size_t hash = 2166136261u;
+		while (*name != '\0')
+		{
+			hash ^= static_cast<unsigned char>(*name++);
+			hash *= 16777619u;
+		}
+		return hash;
+	}
+
+	// "<messages per second>[/<burst>]"
+	bool ParseRateLimit(string const &value, CRateLimiter::Limit &dest)
+	{
+		// "%u" happily turns "-5" into a huge number
+		if (value.find('-') != string::npos)
+			return false;
+
+		unsigned int rate = 0, burst = 0;
+		char slash = '\0';
+		const int count = std::sscanf(value.c_str(), "%u%c%u", &rate, &slash, &burst);
+		if (count != 1 && (count != 3 || slash != '/'))
+			return false;
+
+		dest.rate = rate;
+		dest.burst = burst;
+		return true;
+	}
+
+	// limits set for a module override the ones set for all modules
+	void MergeRateLimit(CRateLimiter::Limit &dest, CRateLimiter::Limit const &specific)
+	{
+		if (specific.rate != 0)
+			dest = specific;
+	}
+}
+
+
+CModule::CModule(ModuleId id, string name, int levels, size_t flight_recorder_size,
+	CRateLimiter *rate_limiter) :
+	id(id),
+	name(std::move(name)),
+	file_path("logs/" + this->name + ".log"),
+	binary_file_path("logs/" + this->name + ".bin"),
+	prefix("[" + this->name + "] "),
+	log_levels(levels),
+	flight_recorder(flight_recorder_size != 0
+		? new CFlightRecorder(flight_recorder_size) : nullptr),
+	rate_limiter(rate_limiter)
+{
+	//create possibly non-existing folders before the log file gets opened
+	size_t pos = 0;
+	while ((pos = this->name.find('/', pos)) != std::string::npos)
+		filesystem::CreateFolder("logs/" + this->name.substr(0, pos++));
+}
+
+
+CModuleRegistry::CModuleRegistry()
+{
+	for (auto &m : m_Modules)
+		m.store(nullptr, std::memory_order_relaxed);
+	for (auto &m : m_HashTable)
+		m.store(nullptr, std::memory_order_relaxed);
+
+	filesystem::CreateFolder("logs");
+
+	// "logcore_loglevel <module>=<level> ...", enables the
+	// given level and everything more severe for that module
+	std::vector<string> entries;
+	CSampConfigReader::Get()->GetVarList("logcore_loglevel", entries);
+	for (auto const &e : entries)
+	{
+		const size_t pos = e.find('=');
+		LogLevel level;
+		if (pos == string::npos || pos == 0 || !ParseLogLevel(e.substr(pos + 1), level))
+			continue;
+
+		m_ConfiguredLogLevels[e.substr(0, pos)] = GetLogLevelsFrom(level);
+	}
+
+	// "logcore_ratelimit <module>[:<level>]=<messages per second>[/<burst>] ...",
+	// '*' as module name sets the limit for every module
+	entries.clear();
+	CSampConfigReader::Get()->GetVarList("logcore_ratelimit", entries);
+	for (auto const &e : entries)
+	{
+		const size_t pos = e.find('=');
+		CRateLimiter::Limit limit;
+		if (pos == string::npos || pos == 0 || !ParseRateLimit(e.substr(pos + 1), limit)
+			|| limit.rate == 0)
+		{
+			continue;
+		}
+
+		string module = e.substr(0, pos);
+		const size_t level_pos = module.find(':');
+		if (level_pos == string::npos)
+		{
+			m_ConfiguredRateLimits[module].module = limit;
+			continue;
+		}
+
+		LogLevel level;
+		if (!ParseLogLevel(module.substr(level_pos + 1), level))
+			continue;
+		const size_t index = CRateLimiter::GetLevelIndex(level);
+		if (index == CRateLimiter::LevelCount)
+			continue;
+
+		module.erase(level_pos);
+		m_ConfiguredRateLimits[module].levels[index] = limit;
+	}
+
+	int flight_recorder_size;
+	if (CSampConfigReader::Get()->GetVar("logcore_flightrecorder", flight_recorder_size)
+		&& flight_recorder_size > 0)
+	{
+		m_FlightRecorderSize = flight_recorder_size;
+	}
+}
+
+CModuleRegistry::~CModuleRegistry()
+{
+	for (auto &m : m_Modules)
+		delete m.load(std::memory_order_relaxed);
+}
+
+ModuleId CModuleRegistry::Register(const char *name)
+{
+	if (name == nullptr || name[0] == '\0')
+		return InvalidModuleId;
+
+	const size_t hash = HashModuleName(name);
+	size_t index = hash & (HashTableSize - 1);
+
+	// fast path: module is already registered
+	for (size_t i = 0; i != HashTableSize; ++i)
+	{
+		CModule *module = m_HashTable[index].load(std::memory_order_acquire);
+		if (module == nullptr)
+			break;
+		if (module->name == name)
+			return module->id;
+		index = (index + 1) & (HashTableSize - 1);
+	}
+
+	std::lock_guard<std::mutex> lg(m_RegisterMtx);
+
+	// continue probing, another thread could have registered it in the meantime
+	for (size_t i = 0; i != HashTableSize; ++i)
+	{
+		CModule *module = m_HashTable[index].load(std::memory_order_acquire);
+		if (module == nullptr)
+			break;
+		if (module->name == name)
+			return module->id;
+		index = (index + 1) & (HashTableSize - 1);
+	}
+
+	if (m_NextId > MaxModules)
+	{
+		m_LimitReached.store(true, std::memory_order_relaxed);
+		return InvalidModuleId;
+	}
+
+	auto cfg_it = m_ConfiguredLogLevels.find(name);
+	CModule *module = new CModule(m_NextId, name,
+		cfg_it != m_ConfiguredLogLevels.end() ? cfg_it->second : LogLevelsUnset,
+		m_FlightRecorderSize, CreateRateLimiter(name));
+	m_Modules[module->id].store(module, std::memory_order_release);
+	m_HashTable[index].store(module, std::memory_order_release);
+	m_NextId.store(module->id + 1, std::memory_order_release);
+	return module->id;
+}
+
+CRateLimiter *CModuleRegistry::CreateRateLimiter(const char *name) const
+{
+	auto all_it = m_ConfiguredRateLimits.find("*"),
+		module_it = m_ConfiguredRateLimits.find(name);
+	if (all_it == m_ConfiguredRateLimits.end() && module_it == m_ConfiguredRateLimits.end())
+		return nullptr;
+
+	RateLimits limits;
+	if (all_it != m_ConfiguredRateLimits.end())
+		limits = all_it->second;
+	if (module_it != m_ConfiguredRateLimits.end())
+	{
+		RateLimits const &specific = module_it->second;
+		MergeRateLimit(limits.module, specific.module);
+		for (size_t i = 0; i != CRateLimiter::LevelCount; ++i)
+			MergeRateLimit(limits.levels[i], specific.levels[i]);
+	}
+	return new CRateLimiter(limits.module, limits.levels);
+}
+
+bool CModuleRegistry::SetLogLevels(ModuleId id, int levels)
+{
+	CModule *module = GetModule(id);
+	if (module == nullptr)
+		return false;
+
+	module->log_levels.store(levels < 0 ? LogLevelsUnset : levels, std::memory_order_relaxed);
+	++m_LogLevelGeneration;
+	return true;
+}
+
+
+unsigned int samplog_RegisterModule(const char *module)
+{
+	return CModuleRegistry::Get()->Register(module);
+}
+
+bool samplog_SetModuleLogLevel(const char *module, int levels)
+{
+	CModuleRegistry *registry = CModuleRegistry::Get();
+	return registry->SetLogLevels(registry->Register(module), levels);
+}
+
+bool samplog_GetModuleLogLevel(unsigned int module_id, int *levels)
+{
+	CModule *module = CModuleRegistry::Get()->GetModule(module_id);
+	if (module == nullptr || levels == nullptr)
+		return false;
+
+	const int module_levels = module->log_levels.load(std::memory_order_relaxed);
+	if (module_levels == LogLevelsUnset)
+		return false;
+
+	*levels = module_levels;
+	return true;
+}
+
+unsigned int samplog_GetLogLevelGeneration()
+{
+	return CModuleRegistry::Get()->GetLogLevelGeneration();
+}
+
+const void *samplog_GetLogLevelGenerationAddress()
+{
+	static_assert(sizeof(std::atomic<unsigned int>) == sizeof(unsigned int),
+		"plugins read the generation as std::atomic<unsigned int>");
+	return CModuleRegistry::Get()->GetLogLevelGenerationAddress();
+}
+
+bool samplog_IsFlightRecorderEnabled()
+{
+	return CModuleRegistry::Get()->IsFlightRecorderEnabled();
+}
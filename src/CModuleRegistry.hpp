@@ -0,0 +1,172 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <map>
+#include <cstddef>
+
+#include "CSingleton.hpp"
+#include "CLogStats.hpp"
+#include "CFlightRecorder.hpp"
+#include "CRateLimiter.hpp"
+#include "loglevel.hpp"
+#include "export.h"
+
+using std::string;
+
+
+using ModuleId = unsigned int;
+const ModuleId InvalidModuleId = 0;
+// the module's log levels aren't set by log-core, the plugin decides itself
+const int LogLevelsUnset = -1;
+
+class CModule
+{
+public:
+	// 'flight_recorder_size' 0 disables the flight recorder,
+	// 'rate_limiter' is nullptr if the module has no rate limits
+	CModule(ModuleId id, string name, int levels, size_t flight_recorder_size,
+		CRateLimiter *rate_limiter);
+	~CModule() = default;
+	CModule(const CModule &rhs) = delete;
+	CModule &operator=(const CModule &rhs) = delete;
+
+public:
+	const ModuleId id;
+	const string name;
+	const string file_path; // "logs/<name>.log"
+	const string binary_file_path; // "logs/<name>.bin"
+	const string prefix; // "[<name>] "
+
+	// mask of enabled log levels or LogLevelsUnset
+	std::atomic<int> log_levels;
+
+	inline bool IsLogLevel(LogLevel level) const
+	{
+		const int levels = log_levels.load(std::memory_order_relaxed);
+		return levels == LogLevelsUnset || (levels & level) == level;
+	}
+
+	// messages dropped because the queue was full, since the last summary
+	std::atomic<unsigned int> dropped_messages{ 0 };
+	// messages over the rate limit, since the last summary
+	std::atomic<unsigned int> rate_limited_messages{ 0 };
+
+	CModuleStats stats;
+
+	// messages of disabled log levels, nullptr if disabled
+	const std::unique_ptr<CFlightRecorder> flight_recorder;
+	// nullptr if the module has no rate limits
+	const std::unique_ptr<CRateLimiter> rate_limiter;
+
+	// returns false if the message is over the module's rate limit
+	// and shouldn't be queued, it's counted instead
+	inline bool CheckRateLimit(LogLevel level)
+	{
+		if (!rate_limiter || rate_limiter->TryAcquire(level))
+			return true;
+
+		rate_limited_messages.fetch_add(1, std::memory_order_relaxed);
+		stats.rate_limited_messages.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+};
+
+// interns module names: every module name gets a small integer ID the
+// first time it's seen and keeps it until the process exits
+class CModuleRegistry : public CSingleton<CModuleRegistry>
+{
+	friend class CSingleton<CModuleRegistry>;
+private:
+	CModuleRegistry();
+	~CModuleRegistry();
+
+public:
+	// returns the ID of module 'name', registers it if necessary;
+	// InvalidModuleId if there are MaxModules modules already
+	ModuleId Register(const char *name);
+	// true only the first time it's called after Register ran into MaxModules
+	inline bool TakeLimitReached()
+	{
+		return m_LimitReached.load(std::memory_order_relaxed)
+			&& !m_LimitReported.exchange(true);
+	}
+
+	inline CModule *GetModule(ModuleId id) const
+	{
+		if (id == InvalidModuleId || id > MaxModules)
+			return nullptr;
+		return m_Modules[id].load(std::memory_order_acquire);
+	}
+	// all registered modules have IDs from 1 up to (including) this one
+	inline ModuleId GetLastModuleId() const
+	{
+		return m_NextId.load(std::memory_order_acquire) - 1;
+	}
+
+	// 'levels' is a mask of log levels or LogLevelsUnset
+	bool SetLogLevels(ModuleId id, int levels);
+	inline bool IsFlightRecorderEnabled() const
+	{
+		return m_FlightRecorderSize != 0;
+	}
+	inline bool HasRateLimits() const
+	{
+		return !m_ConfiguredRateLimits.empty();
+	}
+	// changes every time the log levels of any module change
+	inline unsigned int GetLogLevelGeneration() const
+	{
+		return m_LogLevelGeneration.load(std::memory_order_acquire);
+	}
+	// the registry is never destroyed, so plugins may keep this address
+	inline std::atomic<unsigned int> const *GetLogLevelGenerationAddress() const
+	{
+		return &m_LogLevelGeneration;
+	}
+
+public:
+	// fixed, the crash handler keeps a file descriptor per module
+	// and can't allocate any memory
+	static const size_t MaxModules = 1024;
+
+private:
+	// nullptr if neither the module nor all modules have rate limits
+	CRateLimiter *CreateRateLimiter(const char *name) const;
+
+private:
+	static const size_t HashTableSize = MaxModules * 2; // has to be a power of two
+
+	// lookups are lock-free, only registering a new module takes the mutex
+	std::atomic<CModule *> m_Modules[MaxModules + 1]; // indexed by ID
+	std::atomic<CModule *> m_HashTable[HashTableSize];
+
+	std::mutex m_RegisterMtx;
+	std::atomic<ModuleId> m_NextId{ 1 };
+	std::atomic<bool>
+		m_LimitReached{ false },
+		m_LimitReported{ false };
+
+	// log levels from server.cfg, applied when the module gets registered
+	std::map<string, int> m_ConfiguredLogLevels;
+	struct RateLimits
+	{
+		CRateLimiter::Limit module;
+		CRateLimiter::Limit levels[CRateLimiter::LevelCount];
+	};
+	// rate limits from server.cfg, "*" applies to every module
+	std::map<string, RateLimits> m_ConfiguredRateLimits;
+	// number of records kept by the flight recorder of every module
+	size_t m_FlightRecorderSize = 0;
+	std::atomic<unsigned int> m_LogLevelGeneration{ 1 };
+};
+
+
+extern "C" DLL_PUBLIC unsigned int samplog_RegisterModule(const char *module);
+extern "C" DLL_PUBLIC bool samplog_SetModuleLogLevel(const char *module, int levels);
+extern "C" DLL_PUBLIC bool samplog_GetModuleLogLevel(unsigned int module_id, int *levels);
+extern "C" DLL_PUBLIC unsigned int samplog_GetLogLevelGeneration();
+extern "C" DLL_PUBLIC const void *samplog_GetLogLevelGenerationAddress();
+extern "C" DLL_PUBLIC bool samplog_IsFlightRecorderEnabled();
@@ -0,0 +1,105 @@
+#include "CRateLimiter.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+
+CRateLimiter::CRateLimiter(Limit const &module_limit, Limit const (&level_limits)[LevelCount])
+{
+	m_Module.SetLimit(module_limit);
+	for (size_t i = 0; i != LevelCount; ++i)
+		m_Levels[i].SetLimit(level_limits[i]);
+}
+
+bool CRateLimiter::TryAcquire(LogLevel level)
+{
+	const int64_t now = Now();
+
+	const size_t index = GetLevelIndex(level);
+	if (index != LevelCount && m_Levels[index].IsLimited() && !m_Levels[index].TryTake(now))
+		return false;
+
+	if (!m_Module.IsLimited() || m_Module.TryTake(now))
+		return true;
+
+	// the message isn't logged, so it mustn't use up its level's budget
+	if (index != LevelCount && m_Levels[index].IsLimited())
+		m_Levels[index].Refund();
+	return false;
+}
+
+unsigned int CRateLimiter::GetAvailableTokens() const
+{
+	return m_Module.IsLimited() ? m_Module.GetAvailable(Now()) : 0;
+}
+
+size_t CRateLimiter::GetLevelIndex(LogLevel level)
+{
+	switch (level)
+	{
+	case LogLevel::DEBUG:
+		return 0;
+	case LogLevel::INFO:
+		return 1;
+	case LogLevel::WARNING:
+		return 2;
+	case LogLevel::ERROR:
+		return 3;
+	case LogLevel::FATAL:
+		return 4;
+	case LogLevel::VERBOSE:
+		return 5;
+	default:
+		return LevelCount;
+	}
+}
+
+int64_t CRateLimiter::Now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+void CRateLimiter::CBucket::SetLimit(Limit const &limit)
+{
+	m_Rate = limit.rate;
+	if (limit.rate == 0)
+		return;
+
+	const unsigned int burst = limit.burst != 0 ? limit.burst : limit.rate;
+	m_Interval = std::max<int64_t>(1000000000 / limit.rate, 1);
+	// a full bucket lets 'burst' messages through at once
+	m_Tolerance = m_Interval * (burst - 1);
+}
+
+bool CRateLimiter::CBucket::TryTake(int64_t now)
+{
+	int64_t full_at = m_FullAt.load(std::memory_order_relaxed);
+	while (true)
+	{
+		const int64_t start = std::max(full_at, now);
+		if (start - now > m_Tolerance)
+			return false;
+
+		if (m_FullAt.compare_exchange_weak(full_at, start + m_Interval,
+			std::memory_order_relaxed))
+		{
+			return true;
+		}
+	}
+}
+
+void CRateLimiter::CBucket::Refund()
+{
+	m_FullAt.fetch_sub(m_Interval, std::memory_order_relaxed);
+}
+
+unsigned int CRateLimiter::CBucket::GetAvailable(int64_t now) const
+{
+	const int64_t full_at = m_FullAt.load(std::memory_order_relaxed);
+	const int64_t missing = std::max<int64_t>(full_at - now, 0);
+	if (missing > m_Tolerance + m_Interval)
+		return 0;
+	return static_cast<unsigned int>((m_Tolerance + m_Interval - missing) / m_Interval);
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "loglevel.hpp"
+
+
+/*
+  Token buckets of a module: one for all of its messages and one for every
+  log level. A bucket refills 'rate' tokens per second and holds up to
+  'burst' of them. Instead of a token count every bucket keeps the time at
+  which it will be full again (GCRA), so taking a token is a single
+  compare-and-swap and nothing has to refill the buckets periodically.
+*/
+class CRateLimiter
+{
+public:
+	struct Limit
+	{
+		unsigned int rate = 0; // messages per second, '0' means unlimited
+		unsigned int burst = 0; // '0' means 'rate'
+	};
+
+	static const size_t LevelCount = 6; // DEBUG to VERBOSE
+
+	CRateLimiter(Limit const &module_limit, Limit const (&level_limits)[LevelCount]);
+	~CRateLimiter() = default;
+	CRateLimiter(const CRateLimiter &rhs) = delete;
+	CRateLimiter &operator=(const CRateLimiter &rhs) = delete;
+
+public:
+	// returns false if the message exceeds the module or the level budget
+	bool TryAcquire(LogLevel level);
+
+	// the module-wide limit and the tokens currently left in its bucket
+	inline unsigned int GetRate() const
+	{
+		return m_Module.GetRate();
+	}
+	unsigned int GetAvailableTokens() const;
+
+	// index into the level limits, LevelCount for invalid levels
+	static size_t GetLevelIndex(LogLevel level);
+
+private:
+	class CBucket
+	{
+	public:
+		CBucket() = default;
+		CBucket(const CBucket &rhs) = delete;
+		CBucket &operator=(const CBucket &rhs) = delete;
+
+		void SetLimit(Limit const &limit);
+
+		inline bool IsLimited() const
+		{
+			return m_Interval != 0;
+		}
+		inline unsigned int GetRate() const
+		{
+			return m_Rate;
+		}
+		bool TryTake(int64_t now);
+		// gives back a token taken by TryTake
+		void Refund();
+		unsigned int GetAvailable(int64_t now) const;
+
+	private:
+		unsigned int m_Rate = 0;
+		int64_t m_Interval = 0; // nanoseconds per token
+		int64_t m_Tolerance = 0; // how far 'm_FullAt' may be ahead of now
+		// the bucket is full again at this point in time (in nanoseconds)
+		std::atomic<int64_t> m_FullAt{ 0 };
+	};
+
+	static int64_t Now();
+
+private:
+	CBucket m_Module;
+	CBucket m_Levels[LevelCount];
+};
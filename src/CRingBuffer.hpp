@@ -0,0 +1,230 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+
+/*
+  Bounded lock-free queue with pre-allocated slots, based on Dmitry Vyukov's
+  bounded MPMC queue. Producers only contend on the head index, the consumer
+  only touches the tail index; both indices live on their own cache line.
+  Every slot carries a sequence number which tells whether it is free for
+  the producer of the current lap or filled for the consumer. Values can be
+  pushed with an integer key (log-core uses the message's timestamp), which
+  consumers may look at before they own the value; the value itself must
+  not be touched before it's popped, another consumer could take it.
+*/
+template<typename T>
+class CRingBuffer
+{
+public:
+	explicit CRingBuffer(size_t capacity)
+	{
+		// capacity has to be a power of two so we can mask instead of modulo
+		size_t size = 2;
+		while (size < capacity)
+			size <<= 1;
+
+		m_Mask = size - 1;
+		m_Slots = new Slot[size];
+		for (size_t i = 0; i != size; ++i)
+			m_Slots[i].sequence.store(i, std::memory_order_relaxed);
+
+		m_Head.store(0, std::memory_order_relaxed);
+		m_Tail.store(0, std::memory_order_relaxed);
+		m_Processed.store(0, std::memory_order_relaxed);
+	}
+	~CRingBuffer()
+	{
+		delete[] m_Slots;
+	}
+	CRingBuffer(const CRingBuffer &rhs) = delete;
+	CRingBuffer &operator=(const CRingBuffer &rhs) = delete;
+
+public:
+	bool TryPush(T &&value, int64_t key = 0)
+	{
+		Slot *slot;
+		size_t pos = m_Head.load(std::memory_order_relaxed);
+		while (true)
+		{
+			slot = &m_Slots[pos & m_Mask];
+			size_t seq = slot->sequence.load(std::memory_order_acquire);
+			intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+			if (diff == 0)
+			{
+				if (m_Head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (diff < 0)
+			{
+				return false; // full
+			}
+			else
+			{
+				pos = m_Head.load(std::memory_order_relaxed);
+			}
+		}
+
+		slot->value = std::move(value);
+		slot->key.store(key, std::memory_order_relaxed);
+		slot->sequence.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool TryPop(T &dest)
+	{
+		Slot *slot;
+		size_t pos = m_Tail.load(std::memory_order_relaxed);
+		while (true)
+		{
+			slot = &m_Slots[pos & m_Mask];
+			size_t seq = slot->sequence.load(std::memory_order_acquire);
+			intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+			if (diff == 0)
+			{
+				if (m_Tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (diff < 0)
+			{
+				return false; // empty
+			}
+			else
+			{
+				pos = m_Tail.load(std::memory_order_relaxed);
+			}
+		}
+
+		dest = std::move(slot->value);
+		slot->sequence.store(pos + m_Mask + 1, std::memory_order_release);
+		return true;
+	}
+
+	// claims up to 'max_count' consecutive filled slots at once and appends
+	// their values to 'dest', returns the number of values taken
+	template<typename Container>
+	size_t TryPopBatch(Container &dest, size_t max_count)
+	{
+		return TryPopBatchWhile(dest, max_count, [](T const &) { return true; });
+	}
+
+	// like TryPopBatch, but stops at the first value whose key 'pred' returns
+	// false for; the keys are looked at before the values are claimed, if
+	// another consumer takes them meanwhile claiming fails and we start over
+	template<typename Container, typename Predicate>
+	size_t TryPopBatchWhile(Container &dest, size_t max_count, Predicate pred)
+	{
+		size_t pos = m_Tail.load(std::memory_order_relaxed);
+		size_t count;
+		while (true)
+		{
+			count = 0;
+			while (count != max_count)
+			{
+				size_t cur = pos + count;
+				Slot &slot = m_Slots[cur & m_Mask];
+				size_t seq = slot.sequence.load(std::memory_order_acquire);
+				if (static_cast<intptr_t>(seq) - static_cast<intptr_t>(cur + 1) != 0
+					|| !pred(slot.key.load(std::memory_order_relaxed)))
+				{
+					break;
+				}
+				++count;
+			}
+
+			if (count == 0)
+				return 0; // empty
+
+			if (m_Tail.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed))
+				break;
+		}
+
+		for (size_t i = 0; i != count; ++i)
+		{
+			Slot &slot = m_Slots[(pos + i) & m_Mask];
+			dest.push_back(std::move(slot.value));
+			slot.sequence.store(pos + i + m_Mask + 1, std::memory_order_release);
+		}
+		return count;
+	}
+
+	// the key of the value 'offset' positions after the oldest one, without
+	// popping it; returns false if there aren't that many values
+	bool PeekKey(size_t offset, int64_t &dest) const
+	{
+		const size_t pos = m_Tail.load(std::memory_order_relaxed) + offset;
+		Slot const &slot = m_Slots[pos & m_Mask];
+		const size_t seq = slot.sequence.load(std::memory_order_acquire);
+		if (static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1) != 0)
+			return false;
+
+		dest = slot.key.load(std::memory_order_relaxed);
+		// the slot could have been taken and filled again meanwhile
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return slot.sequence.load(std::memory_order_relaxed) == seq;
+	}
+
+	bool IsEmpty() const
+	{
+		size_t pos = m_Tail.load(std::memory_order_relaxed);
+		size_t seq = m_Slots[pos & m_Mask].sequence.load(std::memory_order_acquire);
+		return static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1) < 0;
+	}
+
+	// only a snapshot if producers or consumers are active
+	size_t GetSize() const
+	{
+		const size_t tail = m_Tail.load(std::memory_order_relaxed);
+		const size_t head = m_Head.load(std::memory_order_relaxed);
+		return head > tail ? head - tail : 0;
+	}
+
+	// every value ever pushed has a position below this one
+	size_t GetHeadPosition() const
+	{
+		return m_Head.load(std::memory_order_acquire);
+	}
+	// every value ever popped has a position below this one
+	size_t GetTailPosition() const
+	{
+		return m_Tail.load(std::memory_order_acquire);
+	}
+	// lets the consumer tell others that it's completely done with
+	// all values below 'pos', not just popped them
+	void SetProcessedPosition(size_t pos)
+	{
+		m_Processed.store(pos, std::memory_order_release);
+	}
+	size_t GetProcessedPosition() const
+	{
+		return m_Processed.load(std::memory_order_acquire);
+	}
+
+	size_t GetCapacity() const
+	{
+		return m_Mask + 1;
+	}
+
+private:
+	static const size_t CacheLineSize = 64;
+
+	struct Slot
+	{
+		std::atomic<size_t> sequence;
+		std::atomic<int64_t> key;
+		T value;
+	};
+
+	char m_Pad0[CacheLineSize];
+	Slot *m_Slots;
+	size_t m_Mask;
+	char m_Pad1[CacheLineSize - sizeof(Slot *) - sizeof(size_t)];
+	std::atomic<size_t> m_Head;
+	char m_Pad2[CacheLineSize - sizeof(std::atomic<size_t>)];
+	std::atomic<size_t> m_Tail;
+	std::atomic<size_t> m_Processed;
+	char m_Pad3[CacheLineSize - 2 * sizeof(std::atomic<size_t>)];
+};
@@ -2,6 +2,7 @@
 
 #include <fstream>
 #include <algorithm>
+#include <cstdlib>
 
 
 CSampConfigReader::CSampConfigReader()
@@ -34,6 +35,22 @@ bool CSampConfigReader::GetVar(string varname, string &dest)
 	return false;
 }
 
+bool CSampConfigReader::GetVar(string varname, int &dest)
+{
+	string data;
+	if (GetVar(std::move(varname), data) == false)
+		return false;
+
+	const char *begin = data.c_str();
+	char *end = nullptr;
+	long value = std::strtol(begin, &end, 10);
+	if (end == begin)
+		return false;
+
+	dest = static_cast<int>(value);
+	return true;
+}
+
 bool CSampConfigReader::GetVarList(string varname, vector<string> &dest)
 {
 	dest.clear();
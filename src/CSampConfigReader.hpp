@@ -18,6 +18,7 @@ private:
 
 public:
 	bool GetVar(string varname, string &dest);
+	bool GetVar(string varname, int &dest);
 	bool GetVarList(string varname, vector<string> &dest);
 	bool GetGamemodeList(vector<string> &dest);
 
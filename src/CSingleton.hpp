@@ -1,11 +1,31 @@
 #pragma once
 
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <cstddef>
 
+
+/*
+  Get() is a single acquire load once the instance exists, only creating it
+  takes a mutex. Code which may run while another thread calls Destroy()
+  holds a UseGuard instead: Destroy() waits until all guards are gone.
+  Guards are counted in per-thread slots, so threads using the instance
+  at the same time don't fight over a single counter.
+*/
 template<class T>
 class CSingleton
 {
 protected:
-	static T *m_Instance;
+	static std::atomic<T *> m_Instance;
+
+private:
+	static const size_t GuardSlotCount = 64;
+
+	struct alignas(64) GuardSlot
+	{
+		std::atomic<unsigned int> guards;
+	};
 
 public:
 	CSingleton() { }
@@ -13,20 +33,119 @@ public:
 
 	inline static T *Get()
 	{
-		if (m_Instance == nullptr)
-			m_Instance = new T;
-		return m_Instance;
+		T *instance = m_Instance.load(std::memory_order_acquire);
+		if (instance != nullptr)
+			return instance;
+		return Create();
+	}
+
+	// doesn't create the instance, for code which can't take locks
+	inline static T *GetIfExists()
+	{
+		return m_Instance.load(std::memory_order_acquire);
 	}
 
-	inline static void Destroy()
+	static void Destroy()
+	{
+		std::lock_guard<std::mutex> lg(m_CreateMtx);
+		T *instance = m_Instance.exchange(nullptr);
+		if (instance == nullptr)
+			return;
+
+		// new guards see no instance anymore, wait for the ones still using it
+		// (except those of this thread, e.g. if it crashed while holding one)
+		while (GetGuardCount() != ThreadGuardCount)
+			std::this_thread::yield();
+
+		delete instance;
+	}
+
+	// keeps the instance alive as long as the guard exists,
+	// creates the instance if there's none
+	class UseGuard
+	{
+	public:
+		UseGuard() :
+			m_Slot(GetThreadSlot())
+		{
+			while (true)
+			{
+				// pairs with the exchange in Destroy: either Destroy
+				// sees this guard or the guard sees no instance
+				m_Slot.guards.fetch_add(1);
+				m_Ptr = m_Instance.load();
+				if (m_Ptr != nullptr)
+					break;
+
+				m_Slot.guards.fetch_sub(1, std::memory_order_release);
+				Create();
+			}
+			++ThreadGuardCount;
+		}
+		~UseGuard()
+		{
+			--ThreadGuardCount;
+			m_Slot.guards.fetch_sub(1, std::memory_order_release);
+		}
+		UseGuard(const UseGuard &rhs) = delete;
+		UseGuard &operator=(const UseGuard &rhs) = delete;
+
+		inline T *operator->() const
+		{
+			return m_Ptr;
+		}
+		inline T &operator*() const
+		{
+			return *m_Ptr;
+		}
+
+	private:
+		GuardSlot &m_Slot;
+		T *m_Ptr;
+	};
+
+private:
+	static T *Create()
 	{
-		if (m_Instance != nullptr)
+		std::lock_guard<std::mutex> lg(m_CreateMtx);
+		T *instance = m_Instance.load(std::memory_order_relaxed);
+		if (instance == nullptr)
 		{
-			delete m_Instance;
-			m_Instance = nullptr;
+			instance = new T;
+			m_Instance.store(instance, std::memory_order_release);
 		}
+		return instance;
 	}
+
+	static GuardSlot &GetThreadSlot()
+	{
+		static std::atomic<size_t> next_slot{ 0 };
+		thread_local GuardSlot &slot = m_GuardSlots[next_slot++ % GuardSlotCount];
+		return slot;
+	}
+
+	static unsigned int GetGuardCount()
+	{
+		unsigned int count = 0;
+		for (auto const &s : m_GuardSlots)
+			count += s.guards.load();
+		return count;
+	}
+
+	static std::mutex m_CreateMtx;
+	static GuardSlot m_GuardSlots[GuardSlotCount];
+	// guards held by the current thread
+	static thread_local unsigned int ThreadGuardCount;
 };
 
 template <class T>
-T* CSingleton<T>::m_Instance = nullptr;
+std::atomic<T *> CSingleton<T>::m_Instance{ nullptr };
+
+template <class T>
+std::mutex CSingleton<T>::m_CreateMtx;
+
+template <class T>
+typename CSingleton<T>::GuardSlot CSingleton<T>::m_GuardSlots[CSingleton<T>::GuardSlotCount];
+
+template <class T>
+thread_local unsigned int CSingleton<T>::ThreadGuardCount = 0;
@@ -0,0 +1,47 @@
+#include "CTimestampFormatter.hpp"
+
+#include <algorithm>
+
+#include <fmt/format.h>
+#include <fmt/time.h>
+
+
+string const &CTimestampFormatter::Format(std::chrono::system_clock::time_point time)
+{
+	const std::time_t time_c = std::chrono::system_clock::to_time_t(time);
+	if (time_c != m_CachedTime)
+	{
+		std::tm local_time;
+		GetLocalTime(time_c, local_time);
+		m_CachedString = fmt::format(m_Format, local_time);
+		m_CachedTime = time_c;
+	}
+	return m_CachedString;
+}
+
+void CTimestampFormatter::GetLocalTime(std::time_t time, std::tm &dest)
+{
+	if (time < m_BaseTime || time >= m_BaseValidUntil)
+	{
+		m_BaseLocalTime = fmt::localtime(time);
+		m_BaseTime = time;
+
+		// the cached date and hour only stay valid until the next local hour
+		// starts; that's also when the UTC offset changes in zones whose rules
+		// are in local time, which for zones with a :30 or :45 offset isn't
+		// a full hour in UTC, and a full UTC hour is when it changes in zones
+		// whose rules are in UTC (e.g. the EU)
+		const std::time_t
+			next_utc_hour = time - (time % 3600) + 3600,
+			next_local_hour = time + 3600
+				- (m_BaseLocalTime.tm_min * 60 + m_BaseLocalTime.tm_sec);
+		m_BaseValidUntil = std::min(next_utc_hour, next_local_hour);
+	}
+
+	const int seconds = m_BaseLocalTime.tm_min * 60 + m_BaseLocalTime.tm_sec
+		+ static_cast<int>(time - m_BaseTime);
+
+	dest = m_BaseLocalTime;
+	dest.tm_min = seconds / 60;
+	dest.tm_sec = seconds % 60;
+}
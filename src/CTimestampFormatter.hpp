@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+#include <chrono>
+#include <ctime>
+
+using std::string;
+
+
+// renders message timestamps with the configured date/time format and
+// caches the result, so messages logged in the same second don't have
+// to go through localtime and the formatter again
+class CTimestampFormatter
+{
+public:
+	explicit CTimestampFormatter(string format) :
+		m_Format(std::move(format))
+	{ }
+	~CTimestampFormatter() = default;
+	CTimestampFormatter(const CTimestampFormatter &rhs) = delete;
+	CTimestampFormatter &operator=(const CTimestampFormatter &rhs) = delete;
+
+public:
+	string const &Format(std::chrono::system_clock::time_point time);
+
+private:
+	void GetLocalTime(std::time_t time, std::tm &dest);
+
+private:
+	const string m_Format;
+
+	std::time_t m_CachedTime = -1;
+	string m_CachedString;
+
+	// the local time is only looked up once per hour, everything within
+	// that hour is derived from it
+	std::time_t
+		m_BaseTime = -1,
+		m_BaseValidUntil = -1;
+	std::tm m_BaseLocalTime;
+};
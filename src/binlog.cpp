@@ -0,0 +1,146 @@
+#include "binlog.hpp"
+
+#include <cstring>
+
+
+namespace
+{
+	const char Magic[4] = { 'S', 'L', 'G', 'B' };
+	// sanity limit for sizes read from a file
+	const uint32_t MaxRecordSize = 16 * 1024 * 1024;
+
+	template<typename T>
+	void AppendValue(std::string &dest, T value)
+	{
+		dest.append(reinterpret_cast<const char *>(&value), sizeof(T));
+	}
+
+	void AppendString(std::string &dest, const char *str, size_t length)
+	{
+		AppendValue(dest, static_cast<uint32_t>(length));
+		dest.append(str, length);
+	}
+
+	template<typename T>
+	bool ReadValue(const char *&data, const char *end, T &dest)
+	{
+		if (static_cast<size_t>(end - data) < sizeof(T))
+			return false;
+
+		std::memcpy(&dest, data, sizeof(T));
+		data += sizeof(T);
+		return true;
+	}
+
+	bool ReadString(const char *&data, const char *end, std::string &dest)
+	{
+		uint32_t length;
+		if (!ReadValue(data, end, length) || static_cast<size_t>(end - data) < length)
+			return false;
+
+		dest.assign(data, length);
+		data += length;
+		return true;
+	}
+}
+
+
+namespace binlog
+{
+	void AppendFileHeader(std::string &dest, std::string const &module_name)
+	{
+		dest.append(Magic, sizeof(Magic));
+		AppendValue(dest, Version);
+		AppendString(dest, module_name.c_str(), module_name.length());
+	}
+
+	size_t BeginRecord(std::string &dest, std::chrono::system_clock::time_point time,
+		unsigned int module_id, LogLevel level, const char *text, size_t text_length,
+		size_t call_info_count)
+	{
+		const size_t offset = dest.length();
+		AppendValue(dest, static_cast<uint32_t>(0)); // filled in by FinishRecord
+		AppendValue(dest, static_cast<int64_t>(std::chrono::duration_cast<
+			std::chrono::microseconds>(time.time_since_epoch()).count()));
+		AppendValue(dest, static_cast<uint32_t>(module_id));
+		AppendValue(dest, static_cast<uint32_t>(level));
+		AppendString(dest, text, text_length);
+		AppendValue(dest, static_cast<uint32_t>(call_info_count));
+		return offset;
+	}
+
+	void AppendCallInfo(std::string &dest, int line, const char *file)
+	{
+		AppendValue(dest, static_cast<int32_t>(line));
+		AppendString(dest, file, file != nullptr ? std::strlen(file) : 0);
+	}
+
+	void FinishRecord(std::string &dest, size_t record_offset)
+	{
+		const uint32_t size = static_cast<uint32_t>(
+			dest.length() - record_offset - sizeof(uint32_t));
+		std::memcpy(&dest[record_offset], &size, sizeof(size));
+	}
+
+
+	bool ReadFileHeader(std::FILE *file, std::string &module_name)
+	{
+		char magic[sizeof(Magic)];
+		uint32_t version, name_length;
+		if (std::fread(magic, sizeof(magic), 1, file) != 1
+			|| std::memcmp(magic, Magic, sizeof(Magic)) != 0
+			|| std::fread(&version, sizeof(version), 1, file) != 1
+			|| version != Version
+			|| std::fread(&name_length, sizeof(name_length), 1, file) != 1
+			|| name_length > MaxRecordSize)
+		{
+			return false;
+		}
+
+		module_name.resize(name_length);
+		return name_length == 0
+			|| std::fread(&module_name[0], name_length, 1, file) == 1;
+	}
+
+	bool ReadRecord(std::FILE *file, Record &dest)
+	{
+		uint32_t size;
+		if (std::fread(&size, sizeof(size), 1, file) != 1 || size > MaxRecordSize)
+			return false;
+
+		std::vector<char> buffer(size);
+		if (size != 0 && std::fread(buffer.data(), size, 1, file) != 1)
+			return false;
+
+		const char
+			*data = buffer.data(),
+			*end = data + size;
+		int64_t timestamp;
+		uint32_t module_id, level, call_info_count;
+		if (!ReadValue(data, end, timestamp)
+			|| !ReadValue(data, end, module_id)
+			|| !ReadValue(data, end, level)
+			|| !ReadString(data, end, dest.text)
+			|| !ReadValue(data, end, call_info_count))
+		{
+			return false;
+		}
+
+		dest.timestamp = std::chrono::system_clock::time_point(
+			std::chrono::duration_cast<std::chrono::system_clock::duration>(
+				std::chrono::microseconds(timestamp)));
+		dest.module_id = module_id;
+		dest.level = static_cast<LogLevel>(level);
+
+		dest.call_info.clear();
+		for (uint32_t i = 0; i != call_info_count; ++i)
+		{
+			int32_t line;
+			std::string filename;
+			if (!ReadValue(data, end, line) || !ReadString(data, end, filename))
+				return false;
+			dest.call_info.emplace_back(line, std::move(filename));
+		}
+		return true;
+	}
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <chrono>
+
+#include "loglevel.hpp"
+
+
+/*
+  Binary log format, written instead of the text format if
+  "logcore_outputformat binary" is set. Every module log file starts with a
+  file header, followed by framed records; all values are in host byte order.
+
+  file header: "SLGB", uint32 version, uint32 name length, module name
+  record:      uint32 size of the rest of the record,
+               int64 timestamp (microseconds since the epoch),
+               uint32 module ID, uint32 log level,
+               uint32 text length, text,
+               uint32 call info count, { int32 line, uint32 file length, file }...
+*/
+namespace binlog
+{
+	const uint32_t Version = 1;
+
+	void AppendFileHeader(std::string &dest, std::string const &module_name);
+
+	// starts a record, 'call_info_count' entries have to be appended before
+	// it's finished; returns the offset of the record in 'dest'
+	size_t BeginRecord(std::string &dest, std::chrono::system_clock::time_point time,
+		unsigned int module_id, LogLevel level, const char *text, size_t text_length,
+		size_t call_info_count);
+	void AppendCallInfo(std::string &dest, int line, const char *file);
+	void FinishRecord(std::string &dest, size_t record_offset);
+
+
+	struct Record
+	{
+		std::chrono::system_clock::time_point timestamp;
+		unsigned int module_id;
+		LogLevel level;
+		std::string text;
+		std::vector<std::pair<int, std::string>> call_info; // line, file
+	};
+
+	bool ReadFileHeader(std::FILE *file, std::string &module_name);
+	// returns false at the end of the file or if the record is incomplete
+	bool ReadRecord(std::FILE *file, Record &dest);
+}
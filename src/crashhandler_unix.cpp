@@ -7,17 +7,14 @@
 
 #include <csignal>
 #include <cstring>
+#include <cstdint>
 #include <unistd.h>
+#include <fcntl.h>
 #include <execinfo.h>
-#include <cxxabi.h>
+#include <cstdio>
 #include <cstdlib>
-#include <sstream>
-#include <iostream>
-#include <thread>
+#include <string>
 #include <atomic>
-#include <map>
-#include <mutex>
-#include <fmt/format.h>
 
  // Linux/Clang, OSX/Clang, OSX/gcc
 #if (defined(__clang__) || defined(__APPLE__))
@@ -27,21 +24,136 @@
 #endif
 
 #include "CLogger.hpp"
+#include "CAmxDebugManager.hpp"
+#include "sigsafe.hpp"
 
 
 namespace 
 {
-	const std::map<crashhandler::Signal, std::string> Signals = {
+	const struct
+	{
+		crashhandler::Signal signal;
+		const char *name;
+	} Signals[] = {
 	   {SIGABRT, "SIGABRT"},
 	   {SIGFPE, "SIGFPE"},
 	   {SIGILL, "SIGILL"},
 	   {SIGSEGV, "SIGSEGV"},
 	   {SIGINT, "SIGINT"},
 	};
+	const size_t SignalCount = sizeof(Signals) / sizeof(Signals[0]);
 
-	std::map<crashhandler::Signal, struct sigaction> OldSignalActions;
+	// indexed like 'Signals', only written when installing the handler
+	struct sigaction OldSignalActions[SignalCount];
+	bool HasOldSignalAction[SignalCount] = { };
 
 	
+	// everything below runs in the signal handler, so no allocations, no locks
+	// and no stdio: only async-signal-safe functions and pre-allocated memory
+	size_t GetSignalIndex(crashhandler::Signal signal_number)
+	{
+		for (size_t i = 0; i != SignalCount; ++i)
+		{
+			if (Signals[i].signal == signal_number)
+				return i;
+		}
+		return SignalCount;
+	}
+
+	const char *GetSignalName(crashhandler::Signal signal_number)
+	{
+		const size_t index = GetSignalIndex(signal_number);
+		return index != SignalCount ? Signals[index].name : "unknown signal";
+	}
+
+	// native frames and AMX frames per AMX instance in the crash report
+	const int MaxNativeBacktrace = 64;
+	const size_t MaxAmxCallStack = 32;
+
+	// only used by the first signal, so they can be static
+	char CrashReportPath[64];
+	char CrashReportBuffer[8192];
+	void *NativeBacktrace[MaxNativeBacktrace];
+
+	void WriteAmxCallStacks(sigsafe::CWriter &report)
+	{
+		CAmxDebugManager *debug_manager = CAmxDebugManager::GetIfExists();
+		if (debug_manager == nullptr)
+			return;
+
+		CAmxDebugManager::RegisteredAmx const *entries = debug_manager->GetRegisteredAmx();
+		for (size_t i = 0; i != CAmxDebugManager::MaxRegisteredAmx; ++i)
+		{
+			AMX *amx = entries[i].amx.load(std::memory_order_acquire);
+			if (amx == nullptr)
+				continue;
+			AMX_DBG *amx_dbg = entries[i].debug_info.load(std::memory_order_relaxed);
+
+			report.Append("\nAMX ").AppendHex(reinterpret_cast<uintptr_t>(amx))
+				.Append(" (cip ").AppendHex(static_cast<ucell>(amx->cip))
+				.Append(", frm ").AppendHex(static_cast<ucell>(amx->frm))
+				.Append(amx_dbg == nullptr ? ", no debug info):\n" : "):\n");
+
+			ucell addresses[MaxAmxCallStack];
+			AmxFuncCallInfo call_info[MaxAmxCallStack];
+			bool complete;
+			const size_t count = debug_manager->GetCallStackAddresses(
+				amx, addresses, MaxAmxCallStack, complete);
+			const size_t resolved = CAmxDebugManager::ResolveCallStack(
+				amx_dbg, addresses, count, complete, call_info);
+			for (size_t j = 0; j != count; ++j)
+			{
+				report.Append("  #").AppendNumber(static_cast<long long>(j))
+					.Append(" ").AppendHex(addresses[j]);
+				if (j < resolved)
+				{
+					report.Append(" in ").Append(call_info[j].function)
+						.Append(" at ").Append(call_info[j].file)
+						.Append(":").AppendNumber(call_info[j].line);
+				}
+				report.Append("\n");
+			}
+		}
+	}
+
+	// writes "logs/crash-<timestamp>.log" and returns its path,
+	// nullptr if it couldn't be created
+	const char *WriteCrashReport(int signal_number, siginfo_t *info)
+	{
+		const auto now = std::chrono::system_clock::now();
+		sigsafe::CWriter path(CrashReportPath, sizeof(CrashReportPath));
+		path.Append("logs/crash-").AppendFileTime(now).Append(".log").Append("", 1);
+
+		const int fd = open(CrashReportPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0)
+			return nullptr;
+
+		sigsafe::CWriter report(CrashReportBuffer, sizeof(CrashReportBuffer), fd);
+		report.Append("log-core crash report\n")
+			.Append("time: ").AppendTime(now).Append("\n")
+			.Append("process: ").AppendNumber(getpid()).Append("\n")
+			.Append("signal: ").AppendNumber(signal_number)
+			.Append(" (").Append(GetSignalName(signal_number)).Append(")")
+			.Append(", code: ").AppendNumber(info->si_code)
+			.Append(", errno: ").AppendNumber(info->si_errno);
+		// only set if the kernel sent the signal because of a fault
+		if (info->si_code > 0)
+			report.Append(", address: ").AppendHex(reinterpret_cast<uintptr_t>(info->si_addr));
+		report.Append("\n\nnative backtrace (demangle with c++filt):\n");
+		report.Flush();
+
+		// backtrace_symbols would allocate, this one writes straight to the file;
+		// the symbols stay mangled, __cxa_demangle allocates as well and
+		// there's no demangler that doesn't
+		const int frames = backtrace(NativeBacktrace, MaxNativeBacktrace);
+		backtrace_symbols_fd(NativeBacktrace, frames, fd);
+
+		WriteAmxCallStacks(report);
+		report.Flush();
+		close(fd);
+		return CrashReportPath;
+	}
+
 	bool IsFirstSignal() 
 	{
 		static std::atomic<int> first_exit{ 0 };
@@ -52,17 +164,21 @@ namespace
 	void RestoreSignalHandler(int signal_number) 
 	{
 		//try restoring old action
-		auto it = OldSignalActions.find(signal_number);
-		if (it != OldSignalActions.end())
-			sigaction(signal_number, &(it->second), nullptr);
+		const size_t index = GetSignalIndex(signal_number);
+		if (index != SignalCount && HasOldSignalAction[index])
+			sigaction(signal_number, &OldSignalActions[index], nullptr);
 	}
 
 	void ExitWithDefaultSignalHandler(crashhandler::Signal fatal_signal_id)
 	{
 		const int signal_number = static_cast<int>(fatal_signal_id);
 		RestoreSignalHandler(signal_number);
-		std::cerr << "\n\n" << "[log-core] fatal signal '" << signal_number
-			<< "' (" << Signals.at(fatal_signal_id) << ") catched   \n\n" << std::flush;
+
+		char buffer[128];
+		sigsafe::CWriter msg(buffer, sizeof(buffer), STDERR_FILENO);
+		msg.Append("\n\n[log-core] fatal signal '").AppendNumber(signal_number)
+			.Append("' (").Append(GetSignalName(fatal_signal_id)).Append(") catched   \n\n");
+		msg.Flush();
 
 		raise(signal_number);
 	}
@@ -73,16 +189,28 @@ namespace
 		if (!IsFirstSignal())
 		{
 			while (true)
-				std::this_thread::sleep_for(std::chrono::seconds(1));
+				sleep(1);
 		}
 
-		const std::string err_msg = fmt::format(
-			"signal {:d} ({:s}) catched; shutting log-core down (errno: {}, signal code: {}, exit status: {})",
-			signal_number, Signals.at(signal_number), info->si_errno, info->si_code, info->si_status);
-
-		CLogManager::Get()->QueueLogMessage(std::unique_ptr<CMessage>(new CMessage(
-			"log-core", LogLevel::ERROR, err_msg, { })));
-		CLogManager::Get()->Destroy();
+		// an interrupt isn't a crash
+		const char *report_path = signal_number != SIGINT
+			? WriteCrashReport(signal_number, info) : nullptr;
+
+		char buffer[256];
+		sigsafe::CWriter err_msg(buffer, sizeof(buffer));
+		err_msg.Append("signal ").AppendNumber(signal_number)
+			.Append(" (").Append(GetSignalName(signal_number))
+			.Append(") catched; writing out pending log messages (errno: ").AppendNumber(info->si_errno)
+			.Append(", signal code: ").AppendNumber(info->si_code)
+			.Append(", exit status: ").AppendNumber(info->si_status).Append(")");
+		if (report_path != nullptr)
+			err_msg.Append("; crash report: ").Append(report_path);
+
+		// shutting log-core down properly would mean joining the writer
+		// threads and freeing memory, neither is safe in a signal handler
+		CLogManager *manager = CLogManager::GetIfExists();
+		if (manager != nullptr)
+			manager->WriteOutOnCrash(err_msg.GetData(), err_msg.GetLength());
 
 		ExitWithDefaultSignalHandler(signal_number);
 	}
@@ -96,20 +224,24 @@ namespace crashhandler
 		struct sigaction action, old_action;
 		memset(&action, 0, sizeof(action));
 		memset(&old_action, 0, sizeof(old_action));
+		// the first call may load libgcc, which allocates
+		backtrace(NativeBacktrace, 1);
+
 		sigemptyset(&action.sa_mask);
 		action.sa_sigaction = &SignalHandler;
 		action.sa_flags = SA_SIGINFO;
 
-		for (const auto &signal : Signals) 
+		for (size_t i = 0; i != SignalCount; ++i) 
 		{
-			if (sigaction(signal.first, &action, &old_action) < 0)
+			if (sigaction(Signals[i].signal, &action, &old_action) < 0)
 			{
-				const std::string error = "sigaction - " + signal.second;
+				const std::string error = std::string("sigaction - ") + Signals[i].name;
 				perror(error.c_str());
 			}
-			else
+			else if (!HasOldSignalAction[i])
 			{
-				OldSignalActions.emplace(signal.first, old_action);
+				OldSignalActions[i] = old_action;
+				HasOldSignalAction[i] = true;
 			}
 		}
 	}
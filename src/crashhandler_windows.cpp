@@ -57,9 +57,10 @@ namespace
 			"exception {:#X} ({:s}) from {:s} catched; shutting log-core down",
 			fatal_signal, signal_str, handler ? handler : "invalid");
 
-		CLogManager::Get()->QueueLogMessage(std::unique_ptr<CMessage>(new CMessage(
-			"log-core", LogLevel::ERROR, err_msg, { })));
-		CLogManager::Get()->Destroy();
+		CLogManager *manager = CLogManager::Get();
+		manager->QueueLogMessage(manager->GetLogCoreModule(),
+			LogLevel::ERROR, err_msg.c_str(), err_msg.length());
+		manager->Destroy();
 
 		return EXCEPTION_CONTINUE_EXECUTION;
 	}
@@ -84,9 +85,11 @@ namespace
 	{
 		if (dwCtrlType == CTRL_CLOSE_EVENT)
 		{
-			CLogManager::Get()->QueueLogMessage(std::unique_ptr<CMessage>(new CMessage(
-				"log-core", LogLevel::INFO, "received Windows console close event; shutting log-core down", { })));
-			CLogManager::Get()->Destroy();
+			const std::string msg = "received Windows console close event; shutting log-core down";
+			CLogManager *manager = CLogManager::Get();
+			manager->QueueLogMessage(manager->GetLogCoreModule(),
+				LogLevel::INFO, msg.c_str(), msg.length());
+			manager->Destroy();
 		}
 		return FALSE; //let other handlers have a chance to clean stuff up
 	}
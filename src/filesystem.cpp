@@ -0,0 +1,25 @@
+#include "filesystem.hpp"
+
+#include <algorithm>
+
+#ifdef WIN32
+#  define WIN32_LEAN_AND_MEAN
+#  include <Windows.h>
+#else
+#  include <sys/stat.h>
+#endif
+
+
+namespace filesystem
+{
+	void CreateFolder(std::string foldername)
+	{
+#ifdef WIN32
+		std::replace(foldername.begin(), foldername.end(), '/', '\\');
+		CreateDirectoryA(foldername.c_str(), NULL);
+#else
+		std::replace(foldername.begin(), foldername.end(), '\\', '/');
+		mkdir(foldername.c_str(), ACCESSPERMS);
+#endif
+	}
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <string>
+
+
+namespace filesystem
+{
+	void CreateFolder(std::string foldername);
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <string>
+
 #ifdef ERROR //great job M$
 #  undef ERROR
 #endif
@@ -12,4 +14,66 @@ enum LogLevel
 	INFO = 2,
 	WARNING = 4,
 	ERROR = 8,
+	FATAL = 16,
+	VERBOSE = 32,
 };
+
+// returns a mask of 'level' and all log levels more severe than it
+inline int GetLogLevelsFrom(LogLevel level)
+{
+	if (level == LogLevel::NONE)
+		return 0;
+	if (level == LogLevel::VERBOSE)
+		return LogLevel::VERBOSE | GetLogLevelsFrom(LogLevel::DEBUG);
+
+	// DEBUG to FATAL are ordered by severity
+	return (LogLevel::FATAL | (LogLevel::FATAL - 1)) & ~(level - 1);
+}
+
+inline const char *GetLogLevelName(LogLevel level)
+{
+	switch (level)
+	{
+	case LogLevel::DEBUG:
+		return "DEBUG";
+	case LogLevel::INFO:
+		return "INFO";
+	case LogLevel::WARNING:
+		return "WARNING";
+	case LogLevel::ERROR:
+		return "ERROR";
+	case LogLevel::FATAL:
+		return "FATAL";
+	case LogLevel::VERBOSE:
+		return "VERBOSE";
+	default:
+		return "<unknown>";
+	}
+}
+
+inline bool ParseLogLevel(std::string const &name, LogLevel &dest)
+{
+	static const struct
+	{
+		const char *name;
+		LogLevel level;
+	} Levels[] = {
+		{ "none", LogLevel::NONE },
+		{ "debug", LogLevel::DEBUG },
+		{ "info", LogLevel::INFO },
+		{ "warning", LogLevel::WARNING },
+		{ "error", LogLevel::ERROR },
+		{ "fatal", LogLevel::FATAL },
+		{ "verbose", LogLevel::VERBOSE },
+	};
+
+	for (auto const &l : Levels)
+	{
+		if (name == l.name)
+		{
+			dest = l.level;
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,303 @@
+#include "nativecall.hpp"
+#include "CAmxDebugManager.hpp"
+#include "amx/amx2.h"
+
+#include <cstring>
+#include <cstdint>
+
+#include <fmt/format.h>
+
+
+namespace
+{
+	// maximum number of call info entries resolved for a native call
+	const size_t MaxResolvedCallTrace = 32;
+
+	/*
+	  captured data layout:
+	    AMX_DBG *debug_info
+	    uint32 name length, name
+	    uint32 params format length, params format
+	    cell param values (one per format specifier)
+	    uint32 call stack address count, uint8 complete flag, ucell addresses
+	    uint32 string length, string (one per 's' specifier)
+	*/
+	class CWriter
+	{
+	public:
+		CWriter(char *dest, size_t max_size) :
+			m_Data(dest),
+			m_End(dest + max_size)
+		{ }
+
+		template<typename T>
+		bool Write(T const &value)
+		{
+			return Write(&value, sizeof(T));
+		}
+		bool Write(const void *data, size_t length)
+		{
+			if (GetRemaining() < length)
+				return false;
+			std::memcpy(m_Data, data, length);
+			m_Data += length;
+			return true;
+		}
+		inline size_t GetRemaining() const
+		{
+			return static_cast<size_t>(m_End - m_Data);
+		}
+		inline char *GetCurrent() const
+		{
+			return m_Data;
+		}
+		inline void Skip(size_t length)
+		{
+			m_Data += length;
+		}
+
+	private:
+		char *m_Data;
+		char * const m_End;
+	};
+
+	class CReader
+	{
+	public:
+		CReader(const char *data, size_t length) :
+			m_Data(data),
+			m_End(data + length)
+		{ }
+
+		template<typename T>
+		bool Read(T &dest)
+		{
+			if (static_cast<size_t>(m_End - m_Data) < sizeof(T))
+				return false;
+			std::memcpy(&dest, m_Data, sizeof(T));
+			m_Data += sizeof(T);
+			return true;
+		}
+		// returns nullptr if there's not enough data left
+		const char *Take(size_t length)
+		{
+			if (static_cast<size_t>(m_End - m_Data) < length)
+				return nullptr;
+			const char *data = m_Data;
+			m_Data += length;
+			return data;
+		}
+
+	private:
+		const char *m_Data;
+		const char * const m_End;
+	};
+
+	bool WriteString(CWriter &writer, const char *str, size_t length)
+	{
+		return writer.Write(static_cast<uint32_t>(length))
+			&& writer.Write(str, length);
+	}
+}
+
+
+namespace nativecall
+{
+	size_t Capture(AMX * const amx, cell * const params, const char *name,
+		const char *params_format, size_t max_call_trace_depth,
+		char *dest, size_t max_size)
+	{
+		CWriter writer(dest, max_size);
+
+		const size_t format_len = std::strlen(params_format);
+		CAmxDebugManager *debug_manager = CAmxDebugManager::Get();
+		AMX_DBG *amx_dbg = debug_manager->GetDebugInfo(amx);
+		if (!writer.Write(amx_dbg)
+			|| !WriteString(writer, name, std::strlen(name))
+			|| !WriteString(writer, params_format, format_len))
+		{
+			return 0;
+		}
+
+		for (size_t i = 0; i != format_len; ++i)
+		{
+			cell value = params[i + 1];
+			switch (params_format[i])
+			{
+			case 'd': //decimal
+			case 'i': //integer
+			case 'f': //float
+			case 'h': //hexadecimal
+			case 'x': //
+			case 'b': //binary
+			case 's': //string
+			case '*': //censored output
+			case 'p': //pointer-value
+				break;
+			case 'r': //reference
+			{
+				cell *addr_dest = nullptr;
+				amx_GetAddr(amx, value, &addr_dest);
+				value = static_cast<cell>(reinterpret_cast<uintptr_t>(addr_dest));
+			}	break;
+			default:
+				return 0; //unrecognized format specifier
+			}
+
+			if (!writer.Write(value))
+				return 0;
+		}
+
+		// reserve the address count and the complete flag,
+		// they're only known after walking the stack
+		if (writer.GetRemaining() < sizeof(uint32_t) + sizeof(uint8_t))
+			return 0;
+		char *address_count_dest = writer.GetCurrent();
+		writer.Skip(sizeof(uint32_t) + sizeof(uint8_t));
+
+		uint32_t address_count = 0;
+		bool complete = false;
+		if (amx_dbg != nullptr)
+		{
+			ucell addresses[MaxResolvedCallTrace];
+			address_count = static_cast<uint32_t>(debug_manager->GetCallStackAddresses(
+				amx, addresses, std::min(max_call_trace_depth, MaxResolvedCallTrace),
+				complete));
+			if (!writer.Write(addresses, sizeof(ucell) * address_count))
+				return 0;
+		}
+		const uint8_t complete_flag = complete ? 1 : 0;
+		std::memcpy(address_count_dest, &address_count, sizeof(address_count));
+		std::memcpy(address_count_dest + sizeof(address_count), &complete_flag,
+			sizeof(complete_flag));
+
+		for (size_t i = 0; i != format_len; ++i)
+		{
+			if (params_format[i] != 's')
+				continue;
+
+			cell *addr = nullptr;
+			int length = 0;
+			if (amx_GetAddr(amx, params[i + 1], &addr) != AMX_ERR_NONE
+				|| amx_StrLen(addr, &length) != AMX_ERR_NONE)
+			{
+				addr = nullptr;
+				length = 0;
+			}
+
+			// the string gets truncated if it doesn't fit,
+			// amx_GetString also needs space for the null terminator
+			if (writer.GetRemaining() < sizeof(uint32_t) + 1)
+				return 0;
+			const size_t copy_length = std::min(static_cast<size_t>(length),
+				writer.GetRemaining() - sizeof(uint32_t) - 1);
+
+			writer.Write(static_cast<uint32_t>(copy_length));
+			if (addr != nullptr)
+				amx_GetString(writer.GetCurrent(), addr, 0, copy_length + 1);
+			writer.Skip(copy_length);
+		}
+
+		return max_size - writer.GetRemaining();
+	}
+
+	Message_t Format(CMessagePool &pool, CMessage const &msg)
+	{
+		CReader reader(msg.GetText(), msg.GetTextLength());
+
+		AMX_DBG *amx_dbg = nullptr;
+		uint32_t name_len = 0, format_len = 0;
+		const char *name = nullptr, *params_format = nullptr;
+		reader.Read(amx_dbg);
+		if (reader.Read(name_len))
+			name = reader.Take(name_len);
+		if (reader.Read(format_len))
+			params_format = reader.Take(format_len);
+		const char *param_values = params_format != nullptr
+			? reader.Take(sizeof(cell) * format_len) : nullptr;
+
+		uint32_t address_count = 0;
+		uint8_t complete = 0;
+		const char *addresses = nullptr;
+		if (reader.Read(address_count) && reader.Read(complete)
+			&& address_count <= MaxResolvedCallTrace)
+		{
+			addresses = reader.Take(sizeof(ucell) * address_count);
+		}
+
+		if (name == nullptr || param_values == nullptr || addresses == nullptr)
+		{
+			const char error[] = "<invalid native call data>";
+			return CMessage::Create(pool, msg.timestamp, msg.log_module, msg.loglevel,
+				error, sizeof(error) - 1);
+		}
+
+		fmt::MemoryWriter fmt_msg;
+		fmt_msg << fmt::StringRef(name, name_len) << '(';
+
+		for (uint32_t i = 0; i != format_len; ++i)
+		{
+			if (i != 0)
+				fmt_msg << ", ";
+
+			cell current_param;
+			std::memcpy(&current_param, param_values + sizeof(cell) * i, sizeof(cell));
+			switch (params_format[i])
+			{
+			case 'd': //decimal
+			case 'i': //integer
+				fmt_msg << static_cast<int>(current_param);
+				break;
+			case 'f': //float
+				fmt_msg << amx_ctof(current_param);
+				break;
+			case 'h': //hexadecimal
+			case 'x': //
+				fmt_msg << fmt::hex(current_param);
+				break;
+			case 'b': //binary
+				fmt_msg << fmt::bin(current_param);
+				break;
+			case 's': //string
+			{
+				uint32_t length = 0;
+				const char *str = reader.Read(length) ? reader.Take(length) : nullptr;
+				fmt_msg << '"';
+				if (str != nullptr)
+					fmt_msg << fmt::StringRef(str, length);
+				fmt_msg << '"';
+			}	break;
+			case '*': //censored output
+				fmt_msg << "\"*****\"";
+				break;
+			case 'r': //reference
+			case 'p': //pointer-value
+				fmt_msg << "0x" << fmt::pad(fmt::hexu(static_cast<ucell>(current_param)), 8, '0');
+				break;
+			}
+		}
+		fmt_msg << ')';
+
+		ucell call_addresses[MaxResolvedCallTrace];
+		std::memcpy(call_addresses, addresses, sizeof(ucell) * address_count);
+		AmxFuncCallInfo call_info[MaxResolvedCallTrace];
+		const size_t call_info_count = CAmxDebugManager::ResolveCallStack(
+			amx_dbg, call_addresses, address_count, complete != 0, call_info);
+
+		return CMessage::Create(pool, msg.timestamp, msg.log_module, msg.loglevel,
+			fmt_msg.data(), fmt_msg.size(), call_info, call_info_count);
+	}
+
+	const char *GetName(CMessage const &msg, size_t &length)
+	{
+		CReader reader(msg.GetText(), msg.GetTextLength());
+
+		AMX_DBG *amx_dbg = nullptr;
+		uint32_t name_len = 0;
+		if (!reader.Read(amx_dbg) || !reader.Read(name_len))
+			return nullptr;
+
+		length = name_len;
+		return reader.Take(name_len);
+	}
+}
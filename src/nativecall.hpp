@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+
+#include "amx/amx.h"
+#include "CMessage.hpp"
+#include "CMessagePool.hpp"
+
+
+/*
+  Native calls are logged in two steps: Capture only copies the raw
+  parameter cells, the string parameters and the call stack return
+  addresses, Format turns that into the actual log text and resolves
+  the call stack. Format can run on the writer thread, since the AMX debug
+  info stays loaded as long as log-core is.
+*/
+namespace nativecall
+{
+	// returns the number of bytes written to 'dest', '0' if the parameter
+	// format is invalid or doesn't fit; string parameters are truncated
+	// if they don't fit
+	size_t Capture(AMX * const amx, cell * const params, const char *name,
+		const char *params_format, size_t max_call_trace_depth,
+		char *dest, size_t max_size);
+
+	// 'msg' has to be a CMessage::Type::NATIVE_CALL message
+	Message_t Format(CMessagePool &pool, CMessage const &msg);
+
+	// returns the name of the captured native function without allocating
+	// or touching the debug info, nullptr if the data is invalid
+	const char *GetName(CMessage const &msg, size_t &length);
+}
@@ -0,0 +1,161 @@
+#include "sigsafe.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+
+
+namespace
+{
+	// proleptic Gregorian calendar date from days since 1970-01-01
+	void CivilFromDays(long long days, long long &year, unsigned int &month, unsigned int &day)
+	{
+		days += 719468;
+		const long long era = (days >= 0 ? days : days - 146096) / 146097;
+		const unsigned int doe = static_cast<unsigned int>(days - era * 146097);
+		const unsigned int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+		const unsigned int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+		const unsigned int mp = (5 * doy + 2) / 153;
+		day = doy - (153 * mp + 2) / 5 + 1;
+		month = mp < 10 ? mp + 3 : mp - 9;
+		year = static_cast<long long>(yoe) + era * 400 + (month <= 2 ? 1 : 0);
+	}
+}
+
+
+namespace sigsafe
+{
+	bool Write(int fd, const char *data, size_t length)
+	{
+		while (length != 0)
+		{
+			const ssize_t written = ::write(fd, data, length);
+			if (written < 0)
+			{
+				if (errno == EINTR)
+					continue;
+				return false;
+			}
+			data += written;
+			length -= static_cast<size_t>(written);
+		}
+		return true;
+	}
+
+	CWriter &CWriter::Append(const char *str)
+	{
+		return Append(str, std::strlen(str));
+	}
+
+	CWriter &CWriter::Append(const char *data, size_t length)
+	{
+		while (length != 0)
+		{
+			if (m_Length == m_Size)
+			{
+				if (m_Fd < 0)
+					break; // truncate
+				Flush();
+			}
+
+			const size_t count = std::min(length, m_Size - m_Length);
+			std::memcpy(m_Buffer + m_Length, data, count);
+			m_Length += count;
+			data += count;
+			length -= count;
+		}
+		return *this;
+	}
+
+	CWriter &CWriter::AppendNumber(long long value)
+	{
+		char digits[24];
+		size_t pos = sizeof(digits);
+		unsigned long long abs_value = value < 0
+			? 0ull - static_cast<unsigned long long>(value)
+			: static_cast<unsigned long long>(value);
+		do
+		{
+			digits[--pos] = static_cast<char>('0' + abs_value % 10);
+			abs_value /= 10;
+		} while (abs_value != 0);
+		if (value < 0)
+			digits[--pos] = '-';
+
+		return Append(digits + pos, sizeof(digits) - pos);
+	}
+
+	CWriter &CWriter::AppendHex(unsigned long long value)
+	{
+		char digits[16];
+		size_t pos = sizeof(digits);
+		do
+		{
+			digits[--pos] = "0123456789abcdef"[value & 0xF];
+			value >>= 4;
+		} while (value != 0);
+
+		return Append("0x").Append(digits + pos, sizeof(digits) - pos);
+	}
+
+	CWriter &CWriter::AppendTime(std::chrono::system_clock::time_point time)
+	{
+		static const char * const Separators[] = { "-", "-", " ", ":", ":" };
+		const unsigned int millis = AppendDateTime(time, Separators);
+
+		const char fraction[4] = {
+			'.',
+			static_cast<char>('0' + millis / 100),
+			static_cast<char>('0' + millis / 10 % 10),
+			static_cast<char>('0' + millis % 10)
+		};
+		return Append(fraction, 4).Append(" UTC");
+	}
+
+	CWriter &CWriter::AppendFileTime(std::chrono::system_clock::time_point time)
+	{
+		static const char * const Separators[] = { "", "", "-", "", "" };
+		AppendDateTime(time, Separators);
+		return *this;
+	}
+
+	unsigned int CWriter::AppendDateTime(std::chrono::system_clock::time_point time,
+		const char * const separators[5])
+	{
+		const long long ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+			time.time_since_epoch()).count();
+		const long long seconds = ms / 1000;
+		const long long days = seconds / 86400;
+		const unsigned int day_seconds = static_cast<unsigned int>(seconds % 86400);
+
+		long long year;
+		unsigned int month, day;
+		CivilFromDays(days, year, month, day);
+
+		// fixed width fields, zero padded
+		const unsigned int fields[] = {
+			month, day, day_seconds / 3600, day_seconds / 60 % 60, day_seconds % 60
+		};
+
+		AppendNumber(year);
+		for (size_t i = 0; i != sizeof(fields) / sizeof(fields[0]); ++i)
+		{
+			const char field[2] = {
+				static_cast<char>('0' + fields[i] / 10),
+				static_cast<char>('0' + fields[i] % 10)
+			};
+			Append(separators[i]).Append(field, 2);
+		}
+		return static_cast<unsigned int>(ms % 1000);
+	}
+
+	void CWriter::Flush()
+	{
+		if (m_Fd < 0 || m_Length == 0)
+			return;
+
+		Write(m_Fd, m_Buffer, m_Length);
+		m_Length = 0;
+	}
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <chrono>
+
+
+/*
+  Helpers for code running in a signal handler: they never allocate or lock
+  and only use async-signal-safe system calls, so they can be used even if
+  the signal interrupted malloc or a thread holding a mutex.
+*/
+namespace sigsafe
+{
+	// writes everything, retries on partial writes and EINTR
+	bool Write(int fd, const char *data, size_t length);
+
+	// builds text in a fixed buffer; if a file descriptor is set, the buffer
+	// gets written out whenever it's full, otherwise the text is truncated
+	class CWriter
+	{
+	public:
+		CWriter(char *buffer, size_t size, int fd = -1) :
+			m_Buffer(buffer),
+			m_Size(size),
+			m_Fd(fd)
+		{ }
+		~CWriter()
+		{
+			Flush();
+		}
+		CWriter(const CWriter &rhs) = delete;
+		CWriter &operator=(const CWriter &rhs) = delete;
+
+	public:
+		CWriter &Append(const char *str);
+		CWriter &Append(const char *data, size_t length);
+		CWriter &AppendNumber(long long value);
+		CWriter &AppendHex(unsigned long long value);
+		// "YYYY-MM-DD HH:MM:SS.mmm UTC", the local time zone can't be
+		// looked up safely
+		CWriter &AppendTime(std::chrono::system_clock::time_point time);
+		// "YYYYMMDD-HHMMSS" in UTC, for file names
+		CWriter &AppendFileTime(std::chrono::system_clock::time_point time);
+
+		// does nothing without a file descriptor
+		void Flush();
+
+		inline const char *GetData() const
+		{
+			return m_Buffer;
+		}
+		inline size_t GetLength() const
+		{
+			return m_Length;
+		}
+
+	private:
+		// returns the milliseconds
+		unsigned int AppendDateTime(std::chrono::system_clock::time_point time,
+			const char * const separators[5]);
+
+	private:
+		char * const m_Buffer;
+		const size_t m_Size;
+		size_t m_Length = 0;
+		const int m_Fd;
+	};
+}
@@ -0,0 +1,97 @@
+#include <cstdio>
+#include <string>
+
+#include "binlog.hpp"
+#include "test.hpp"
+
+
+namespace
+{
+	// a temporary file with 'data' in it, positioned at the start
+	std::FILE *CreateFile(std::string const &data)
+	{
+		std::FILE *file = std::tmpfile();
+		if (file == nullptr)
+			return nullptr;
+		std::fwrite(data.data(), 1, data.length(), file);
+		std::rewind(file);
+		return file;
+	}
+}
+
+
+TEST_CASE(BinlogRoundTrip)
+{
+	using namespace std::chrono;
+	// the format keeps microseconds
+	const system_clock::time_point time =
+		time_point_cast<microseconds>(system_clock::now());
+
+	std::string data;
+	binlog::AppendFileHeader(data, "module/sub");
+
+	size_t record = binlog::BeginRecord(data, time, 3, LogLevel::WARNING,
+		"first message", 13, 2);
+	binlog::AppendCallInfo(data, 12, "script.pwn");
+	binlog::AppendCallInfo(data, -1, nullptr);
+	binlog::FinishRecord(data, record);
+
+	record = binlog::BeginRecord(data, time + seconds(1), 3, LogLevel::DEBUG, "", 0, 0);
+	binlog::FinishRecord(data, record);
+
+	std::FILE *file = CreateFile(data);
+	CHECK(file != nullptr);
+	if (file == nullptr)
+		return;
+
+	std::string module_name;
+	CHECK(binlog::ReadFileHeader(file, module_name));
+	CHECK(module_name == "module/sub");
+
+	binlog::Record r;
+	CHECK(binlog::ReadRecord(file, r));
+	CHECK(r.timestamp == time);
+	CHECK(r.module_id == 3 && r.level == LogLevel::WARNING);
+	CHECK(r.text == "first message");
+	CHECK(r.call_info.size() == 2);
+	if (r.call_info.size() == 2)
+	{
+		CHECK(r.call_info[0].first == 12 && r.call_info[0].second == "script.pwn");
+		CHECK(r.call_info[1].first == -1 && r.call_info[1].second.empty());
+	}
+
+	CHECK(binlog::ReadRecord(file, r));
+	CHECK(r.timestamp == time + seconds(1));
+	CHECK(r.level == LogLevel::DEBUG && r.text.empty() && r.call_info.empty());
+
+	CHECK(!binlog::ReadRecord(file, r));
+	CHECK(std::feof(file));
+	std::fclose(file);
+}
+
+TEST_CASE(BinlogTruncatedRecord)
+{
+	std::string data;
+	binlog::AppendFileHeader(data, "crash");
+	const size_t record = binlog::BeginRecord(data, std::chrono::system_clock::now(),
+		1, LogLevel::ERROR, "cut off by a crash", 18, 0);
+	binlog::FinishRecord(data, record);
+	data.resize(data.length() - 5);
+
+	std::FILE *file = CreateFile(data);
+	CHECK(file != nullptr);
+	if (file == nullptr)
+		return;
+
+	std::string module_name;
+	CHECK(binlog::ReadFileHeader(file, module_name));
+	binlog::Record r;
+	CHECK(!binlog::ReadRecord(file, r));
+	std::fclose(file);
+
+	// not a binary log at all
+	file = CreateFile("[01/01/2020 00:00:00] text log\n");
+	CHECK(file != nullptr && !binlog::ReadFileHeader(file, module_name));
+	if (file != nullptr)
+		std::fclose(file);
+}
@@ -0,0 +1,87 @@
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "CFlightRecorder.hpp"
+#include "test.hpp"
+
+
+namespace
+{
+	void AddNumbered(CFlightRecorder &recorder, int first, int count)
+	{
+		char text[32];
+		for (int i = first; i != first + count; ++i)
+		{
+			const int length = std::snprintf(text, sizeof(text), "message %d", i);
+			recorder.Add(LogLevel::DEBUG, text, length, nullptr, 0);
+		}
+	}
+
+	std::vector<std::string> TakeAll(CFlightRecorder &recorder)
+	{
+		std::vector<std::string> texts;
+		recorder.TakeUntil(std::chrono::system_clock::now(),
+			[&texts](CFlightRecorder::Record const &r)
+		{
+			texts.emplace_back(r.text, r.text_length);
+		});
+		return texts;
+	}
+}
+
+
+TEST_CASE(FlightRecorderKeepsLatest)
+{
+	CFlightRecorder recorder(4);
+	AddNumbered(recorder, 0, 10);
+
+	const std::vector<std::string> texts = TakeAll(recorder);
+	CHECK(texts.size() == 4);
+	if (texts.size() == 4)
+	{
+		CHECK(texts.front() == "message 6");
+		CHECK(texts.back() == "message 9");
+	}
+
+	// taken records aren't returned again
+	CHECK(TakeAll(recorder).empty());
+	AddNumbered(recorder, 10, 1);
+	const std::vector<std::string> more = TakeAll(recorder);
+	CHECK(more.size() == 1 && more.front() == "message 10");
+}
+
+TEST_CASE(FlightRecorderTakeUntil)
+{
+	CFlightRecorder recorder(8);
+	AddNumbered(recorder, 0, 2);
+	const auto until = std::chrono::system_clock::now();
+	while (std::chrono::system_clock::now() == until) { }
+	AddNumbered(recorder, 2, 2);
+
+	std::vector<std::string> texts;
+	recorder.TakeUntil(until, [&texts](CFlightRecorder::Record const &r)
+	{
+		texts.emplace_back(r.text, r.text_length);
+	});
+	CHECK(texts.size() == 2);
+	CHECK(TakeAll(recorder).size() == 2);
+}
+
+TEST_CASE(FlightRecorderTruncatesText)
+{
+	CFlightRecorder recorder(1);
+	const std::string text(CFlightRecorder::MaxTextLength + 50, 'x');
+	const AmxFuncCallInfo call_info = { 7, "script.pwn", "func" };
+	recorder.Add(LogLevel::INFO, text.c_str(), text.length(), &call_info, 1);
+
+	size_t count = 0;
+	recorder.TakeUntil(std::chrono::system_clock::now(),
+		[&count](CFlightRecorder::Record const &r)
+	{
+		++count;
+		CHECK(r.text_length == CFlightRecorder::MaxTextLength);
+		CHECK(r.level == LogLevel::INFO && r.call_info.line == 7);
+	});
+	CHECK(count == 1);
+}
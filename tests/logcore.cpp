@@ -0,0 +1,177 @@
+#include "logcore.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__)
+#  define WIN32_LEAN_AND_MEAN
+#  include <Windows.h>
+#  include <direct.h>
+#else
+#  include <unistd.h>
+#endif
+
+#include <tinydir/tinydir.h>
+#include <samplog/Logger.h>
+
+
+namespace
+{
+	std::string OriginalDirectory;
+	std::string TempDirectory;
+
+	bool CreateTempDirectory(std::string &dest)
+	{
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__)
+		char temp_path[MAX_PATH];
+		if (GetTempPathA(sizeof(temp_path), temp_path) == 0)
+			return false;
+		for (unsigned int i = 0; i != 100; ++i)
+		{
+			dest = std::string(temp_path) + "log-core-tests-"
+				+ std::to_string(GetCurrentProcessId()) + "-" + std::to_string(i);
+			if (_mkdir(dest.c_str()) == 0)
+				return true;
+		}
+		return false;
+#else
+		const char *temp_path = std::getenv("TMPDIR");
+		std::string path_template = std::string(temp_path != nullptr ? temp_path : "/tmp")
+			+ "/log-core-tests-XXXXXX";
+		if (mkdtemp(&path_template[0]) == nullptr)
+			return false;
+		dest = path_template;
+		return true;
+#endif
+	}
+
+	std::string GetWorkingDirectory()
+	{
+		char path[4096];
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__)
+		return _getcwd(path, sizeof(path)) != nullptr ? path : "";
+#else
+		return getcwd(path, sizeof(path)) != nullptr ? path : "";
+#endif
+	}
+
+	bool ChangeDirectory(std::string const &path)
+	{
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__)
+		return _chdir(path.c_str()) == 0;
+#else
+		return chdir(path.c_str()) == 0;
+#endif
+	}
+
+	void RemoveDirectory(std::string const &path)
+	{
+		tinydir_dir dir;
+		if (tinydir_open(&dir, path.c_str()) != 0)
+			return;
+
+		while (dir.has_next)
+		{
+			tinydir_file file;
+			tinydir_readfile(&dir, &file);
+			if (file.is_dir)
+			{
+				if (std::strcmp(file.name, ".") != 0 && std::strcmp(file.name, "..") != 0)
+					RemoveDirectory(file.path);
+			}
+			else
+			{
+				std::remove(file.path);
+			}
+			tinydir_next(&dir);
+		}
+		tinydir_close(&dir);
+
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__)
+		_rmdir(path.c_str());
+#else
+		rmdir(path.c_str());
+#endif
+	}
+}
+
+
+namespace test
+{
+	bool StartLogCore(std::vector<std::string> const &config)
+	{
+		OriginalDirectory = GetWorkingDirectory();
+		if (!CreateTempDirectory(TempDirectory) || !ChangeDirectory(TempDirectory))
+		{
+			std::fputs("can't create a temporary directory\n", stderr);
+			return false;
+		}
+
+		std::FILE *config_file = std::fopen("server.cfg", "w");
+		if (config_file == nullptr)
+			return false;
+		for (auto const &line : config)
+			std::fprintf(config_file, "%s\n", line.c_str());
+		std::fclose(config_file);
+
+		samplog_Init();
+		return true;
+	}
+
+	void StopLogCore()
+	{
+		samplog_Exit();
+		if (TempDirectory.empty())
+			return;
+
+		ChangeDirectory(OriginalDirectory);
+		RemoveDirectory(TempDirectory);
+		TempDirectory.clear();
+	}
+
+	std::vector<std::string> ReadLogMessages(const char *path)
+	{
+		std::vector<std::string> messages;
+		std::ifstream file(path);
+		std::string line;
+		while (std::getline(file, line))
+		{
+			// "[<time>] [<level>] <message>"
+			size_t pos = line.find("] [");
+			if (pos != std::string::npos)
+				pos = line.find("] ", pos + 2);
+			messages.push_back(pos != std::string::npos ? line.substr(pos + 2) : line);
+		}
+		return messages;
+	}
+
+	bool FileExists(const char *path)
+	{
+		std::FILE *file = std::fopen(path, "rb");
+		if (file == nullptr)
+			return false;
+		std::fclose(file);
+		return true;
+	}
+
+	std::vector<std::string> ListFiles(const char *path)
+	{
+		std::vector<std::string> files;
+		tinydir_dir dir;
+		if (tinydir_open(&dir, path) != 0)
+			return files;
+
+		while (dir.has_next)
+		{
+			tinydir_file file;
+			tinydir_readfile(&dir, &file);
+			if (!file.is_dir)
+				files.push_back(file.name);
+			tinydir_next(&dir);
+		}
+		tinydir_close(&dir);
+		return files;
+	}
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+
+/*
+  Runs log-core through its public API, like a plugin would. log-core reads
+  server.cfg only once per process, so every test of CLogManager has to run
+  in a process of its own (see CMakeLists.txt).
+*/
+namespace test
+{
+	// creates a temporary directory with 'config' as server.cfg, makes it
+	// the current directory and initializes log-core
+	bool StartLogCore(std::vector<std::string> const &config);
+	// shuts log-core down, which writes everything still queued, and
+	// removes the temporary directory again
+	void StopLogCore();
+
+	// the lines of a log file, without the timestamp and log level prefix
+	std::vector<std::string> ReadLogMessages(const char *path);
+	bool FileExists(const char *path);
+	// the names of the files in a directory
+	std::vector<std::string> ListFiles(const char *path);
+}
@@ -0,0 +1,49 @@
+#include <cstdio>
+#include <cstring>
+
+#include "test.hpp"
+
+
+namespace
+{
+	bool CurrentFailed = false;
+}
+
+namespace test
+{
+	std::vector<Case> &GetCases()
+	{
+		static std::vector<Case> cases;
+		return cases;
+	}
+
+	void Fail(const char *file, int line, const char *expr)
+	{
+		std::printf("  %s:%d: CHECK(%s) failed\n", file, line, expr);
+		CurrentFailed = true;
+	}
+}
+
+// usage: <test executable> [<test name>]
+int main(int argc, char *argv[])
+{
+	const char *filter = argc > 1 ? argv[1] : nullptr;
+
+	size_t run = 0, failed = 0;
+	for (auto const &c : test::GetCases())
+	{
+		if (filter != nullptr && std::strcmp(c.name, filter) != 0)
+			continue;
+
+		CurrentFailed = false;
+		c.func();
+		++run;
+		if (CurrentFailed)
+			++failed;
+		std::printf("[%s] %s\n", CurrentFailed ? "FAIL" : " OK ", c.name);
+	}
+
+	std::printf("%zu tests, %zu failed\n", run, failed);
+	// a misspelled test name mustn't pass
+	return run != 0 && failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,436 @@
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <chrono>
+
+#include <samplog/Logger.h>
+#include "logcore.hpp"
+#include "test.hpp"
+
+using samplog::LogLevel;
+
+
+namespace
+{
+	// parses "<thread> <index> ..." messages
+	bool ParseNumbered(std::string const &message, unsigned int &thread, unsigned int &index)
+	{
+		return std::sscanf(message.c_str(), "%u %u", &thread, &index) == 2;
+	}
+
+	// logs "<thread> <index> <padding>" from 'threads' threads at once,
+	// with the log level 'get_level(index)'
+	template<typename F>
+	void LogNumbered(const char *module, unsigned int threads, unsigned int per_thread,
+		size_t padding_length, F get_level)
+	{
+		const std::string padding(padding_length, 'x');
+		std::vector<std::thread> producers;
+		for (unsigned int t = 0; t != threads; ++t)
+		{
+			producers.emplace_back([=, &padding]()
+			{
+				for (unsigned int i = 0; i != per_thread; ++i)
+				{
+					const std::string text = std::to_string(t) + " " + std::to_string(i)
+						+ " " + padding;
+					samplog::LogMessage(module, get_level(i), text.c_str());
+				}
+			});
+		}
+		for (auto &t : producers)
+			t.join();
+	}
+
+	// the numbered messages of a module log
+	struct NumberedLog
+	{
+		std::vector<std::vector<unsigned int>> indices; // per thread
+		size_t count = 0;
+		size_t drop_summaries = 0;
+		bool valid = true; // parseable and in order per thread
+	};
+
+	NumberedLog ReadNumbered(const char *path, unsigned int threads)
+	{
+		NumberedLog log;
+		log.indices.resize(threads);
+		for (auto const &m : test::ReadLogMessages(path))
+		{
+			if (m.find(" messages dropped because the log queue was full") != std::string::npos)
+			{
+				++log.drop_summaries;
+				continue;
+			}
+
+			unsigned int thread, index;
+			if (!ParseNumbered(m, thread, index) || thread >= threads
+				|| (!log.indices[thread].empty() && index <= log.indices[thread].back()))
+			{
+				log.valid = false;
+				continue;
+			}
+			log.indices[thread].push_back(index);
+			++log.count;
+		}
+		return log;
+	}
+}
+
+
+TEST_CASE(LogManagerDropOldestStress)
+{
+	// producers throw away the oldest messages while the writer drains the
+	// same queues; the messages don't fit into a pool block, so a writer
+	// touching a dropped one would read freed heap memory
+	CHECK(test::StartLogCore({
+		"logcore_queuesize 64",
+		"logcore_overflowpolicy drop_oldest",
+	}));
+
+	const unsigned int Threads = 4, PerThread = 20000;
+	LogNumbered("stress", Threads, PerThread, 600, [](unsigned int) { return LogLevel::INFO; });
+	CHECK(samplog::Flush(30000));
+	samplog_Stats stats;
+	CHECK(samplog::GetStats(samplog::RegisterModule("stress"), stats));
+	CHECK(stats.dropped_messages != 0);
+
+	// whatever is left of every producer is still in order; the writer
+	// reports the drops in the module log as well
+	const NumberedLog log = ReadNumbered("logs/stress.log", Threads);
+	CHECK(log.valid);
+	CHECK(log.count + stats.dropped_messages == Threads * PerThread);
+	CHECK(log.count + log.drop_summaries == stats.messages_written);
+
+	test::StopLogCore();
+}
+
+TEST_CASE(LogManagerMergeOrder)
+{
+	// every thread has a queue of its own, bigger than a writer batch; the
+	// writer has to merge them by timestamp, whether they're saturated or
+	// get pushed to while it drains them one after another
+	CHECK(test::StartLogCore({
+		"logcore_queuesize 8192",
+		"logcore_overflowpolicy block",
+		"logcore_blocktimeout 60000",
+	}));
+
+	const unsigned int Threads = 4, PerThread = 50000;
+	std::mutex order_mtx;
+	unsigned int counter = 0;
+	auto last_time = std::chrono::system_clock::now();
+	std::vector<std::thread> threads;
+	for (unsigned int t = 0; t != Threads; ++t)
+	{
+		threads.emplace_back([&, t]()
+		{
+			for (unsigned int i = 0; i != PerThread; ++i)
+			{
+				// one message after the other, every one with a later
+				// timestamp than the one before
+				std::lock_guard<std::mutex> lg(order_mtx);
+				while (std::chrono::system_clock::now() == last_time)
+					std::this_thread::yield();
+				const std::string text = std::to_string(t) + " " + std::to_string(counter++);
+				samplog::LogMessage("merge", LogLevel::INFO, text.c_str());
+				last_time = std::chrono::system_clock::now();
+			}
+		});
+	}
+	for (auto &t : threads)
+		t.join();
+	CHECK(samplog::Flush(30000));
+
+	const std::vector<std::string> messages = test::ReadLogMessages("logs/merge.log");
+	CHECK(messages.size() == Threads * PerThread);
+	unsigned int expected = 0;
+	for (auto const &m : messages)
+	{
+		unsigned int thread, index;
+		if (!ParseNumbered(m, thread, index) || index != expected)
+			break;
+		++expected;
+	}
+	CHECK(expected == Threads * PerThread);
+
+	test::StopLogCore();
+}
+
+TEST_CASE(LogManagerDropNewest)
+{
+	CHECK(test::StartLogCore({
+		"logcore_queuesize 64",
+		"logcore_overflowpolicy drop_newest",
+	}));
+
+	const unsigned int Threads = 4, PerThread = 20000;
+	LogNumbered("overflow", Threads, PerThread, 600, [](unsigned int) { return LogLevel::INFO; });
+	CHECK(samplog::Flush(30000));
+	samplog_Stats stats;
+	CHECK(samplog::GetStats(samplog::RegisterModule("overflow"), stats));
+	CHECK(stats.dropped_messages != 0);
+
+	const NumberedLog log = ReadNumbered("logs/overflow.log", Threads);
+	CHECK(log.valid);
+	CHECK(log.count + stats.dropped_messages == Threads * PerThread);
+	// nothing was waiting in front of the first message of a thread
+	for (auto const &indices : log.indices)
+		CHECK(!indices.empty() && indices.front() == 0);
+
+	test::StopLogCore();
+}
+
+TEST_CASE(LogManagerBlock)
+{
+	CHECK(test::StartLogCore({
+		"logcore_queuesize 64",
+		"logcore_overflowpolicy block",
+		"logcore_blocktimeout 60000",
+	}));
+
+	const unsigned int Threads = 4, PerThread = 20000;
+	LogNumbered("overflow", Threads, PerThread, 600, [](unsigned int) { return LogLevel::INFO; });
+	CHECK(samplog::Flush(30000));
+	samplog_Stats stats;
+	CHECK(samplog::GetStats(samplog::RegisterModule("overflow"), stats));
+	CHECK(stats.dropped_messages == 0);
+
+	const NumberedLog log = ReadNumbered("logs/overflow.log", Threads);
+	CHECK(log.valid);
+	CHECK(log.count == Threads * PerThread);
+
+	test::StopLogCore();
+}
+
+TEST_CASE(LogManagerDropBelowWarning)
+{
+	CHECK(test::StartLogCore({
+		"logcore_queuesize 64",
+		"logcore_overflowpolicy drop_below_warning",
+		"logcore_blocktimeout 60000",
+	}));
+
+	// every tenth message is a warning
+	const unsigned int Threads = 4, PerThread = 20000;
+	auto is_warning = [](unsigned int index) { return index % 10 == 9; };
+	LogNumbered("overflow", Threads, PerThread, 600, [=](unsigned int index)
+	{
+		return is_warning(index) ? LogLevel::WARNING : LogLevel::INFO;
+	});
+	CHECK(samplog::Flush(30000));
+	samplog_Stats stats;
+	CHECK(samplog::GetStats(samplog::RegisterModule("overflow"), stats));
+	CHECK(stats.dropped_messages != 0);
+
+	const NumberedLog log = ReadNumbered("logs/overflow.log", Threads);
+	CHECK(log.valid);
+	CHECK(log.count + stats.dropped_messages == Threads * PerThread);
+	size_t warnings = 0;
+	for (auto const &indices : log.indices)
+	{
+		for (unsigned int index : indices)
+			warnings += is_warning(index) ? 1 : 0;
+	}
+	CHECK(warnings == Threads * PerThread / 10);
+
+	test::StopLogCore();
+}
+
+TEST_CASE(LogManagerFlush)
+{
+	// nothing would reach the disk before the shutdown otherwise
+	CHECK(test::StartLogCore({
+		"logcore_flushsize 1024",
+		"logcore_flushinterval 60000",
+		"logcore_flushlevel none",
+		"logcore_writerthreads 2",
+	}));
+
+	// modules on both writer threads
+	const char *modules[] = { "flush-a", "flush-b" };
+	CHECK(samplog::RegisterModule(modules[0]) % 2 != samplog::RegisterModule(modules[1]) % 2);
+	auto log_messages = [&modules](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int i = begin; i != end; ++i)
+		{
+			for (const char *module : modules)
+				samplog::LogMessage(module, LogLevel::INFO, std::to_string(i).c_str());
+		}
+	};
+
+	log_messages(0, 100);
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	CHECK(test::ReadLogMessages("logs/flush-a.log").size() < 100);
+
+	CHECK(samplog::Flush(10000));
+	CHECK(test::ReadLogMessages("logs/flush-a.log").size() == 100);
+	CHECK(test::ReadLogMessages("logs/flush-b.log").size() == 100);
+
+	log_messages(100, 200);
+	CHECK(samplog::Flush(10000, true));
+	const std::vector<std::string> messages = test::ReadLogMessages("logs/flush-b.log");
+	CHECK(messages.size() == 200 && messages.back() == "199");
+
+	test::StopLogCore();
+}
+
+TEST_CASE(LogManagerDuplicates)
+{
+	CHECK(test::StartLogCore({
+		"logcore_duplicatewindow 1000",
+	}));
+
+	for (unsigned int i = 0; i != 100; ++i)
+		samplog::LogMessage("duplicates", LogLevel::INFO, "spam");
+	// another log level isn't a repeat
+	samplog::LogMessage("duplicates", LogLevel::WARNING, "spam");
+	samplog::LogMessage("duplicates", LogLevel::INFO, "something else");
+	// long enough for the repeats to be reported
+	std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+	CHECK(samplog::Flush(10000));
+
+	samplog_Stats stats;
+	CHECK(samplog::GetStats(samplog::RegisterModule("duplicates"), stats));
+	CHECK(stats.duplicate_messages != 0);
+
+	// a slow machine could start another window in between, but every
+	// single message is either written or counted in a summary
+	size_t spam = 0, other = 0, repeats = 0;
+	for (auto const &m : test::ReadLogMessages("logs/duplicates.log"))
+	{
+		unsigned int count;
+		if (m == "spam")
+			++spam;
+		else if (m == "something else")
+			++other;
+		else if (std::sscanf(m.c_str(), "last message repeated %u times: spam", &count) == 1)
+			repeats += count;
+	}
+	CHECK(spam >= 2); // the warning included
+	CHECK(spam + repeats == 101);
+	CHECK(repeats == stats.duplicate_messages);
+	CHECK(other == 1);
+
+	test::StopLogCore();
+}
+
+TEST_CASE(LogManagerRotation)
+{
+	CHECK(test::StartLogCore({
+		"logcore_rotatesize 1",
+		"logcore_rotatekeep 3",
+		"logcore_rotatecompress 0",
+	}));
+
+	// about 20 kilobytes in total
+	const unsigned int Count = 200;
+	const std::string padding(100, 'x');
+	for (unsigned int i = 0; i != Count; ++i)
+	{
+		const std::string text = std::to_string(i) + " " + padding;
+		samplog::LogMessage("rotate", LogLevel::INFO, text.c_str());
+	}
+	CHECK(samplog::Flush(10000));
+
+	// old files are deleted in the background
+	std::vector<std::string> rotated;
+	for (unsigned int tries = 0; tries != 100; ++tries)
+	{
+		rotated.clear();
+		for (auto const &name : test::ListFiles("logs"))
+		{
+			if (name.compare(0, 11, "rotate.log.") == 0)
+				rotated.push_back(name);
+		}
+		if (rotated.size() <= 3)
+			break;
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	}
+	CHECK(rotated.size() == 3);
+
+	// only the newest messages are left, every one of them once
+	std::vector<bool> found(Count, false);
+	size_t lines = 0;
+	bool valid = true;
+	for (auto const &name : rotated)
+	{
+		const std::string path = "logs/" + name;
+		for (auto const &m : test::ReadLogMessages(path.c_str()))
+		{
+			unsigned int index;
+			if (std::sscanf(m.c_str(), "%u", &index) != 1 || index >= Count || found[index])
+				valid = false;
+			else
+				found[index] = true;
+			++lines;
+		}
+	}
+	const std::vector<std::string> current = test::ReadLogMessages("logs/rotate.log");
+	CHECK(!current.empty() && current.back() == std::to_string(Count - 1) + " " + padding);
+	CHECK(valid);
+	CHECK(lines != 0 && lines < Count);
+	CHECK(!found[0]);
+
+	test::StopLogCore();
+}
+
+TEST_CASE(LogManagerFlightRecorderLatency)
+{
+	CHECK(test::StartLogCore({
+		"logcore_flightrecorder 16",
+		"logcore_loglevel recorder=error",
+	}));
+
+	const unsigned int module_id = samplog::RegisterModule("recorder");
+	for (unsigned int i = 0; i != 10; ++i)
+		CHECK(samplog::RecordModuleMessage(module_id, LogLevel::DEBUG, "recorded"));
+	std::this_thread::sleep_for(std::chrono::milliseconds(200));
+	CHECK(samplog::LogModuleMessage(module_id, LogLevel::ERROR, "error"));
+	CHECK(samplog::Flush(10000));
+
+	// the recorded messages are written, but their age isn't a buffer latency
+	samplog_Stats stats;
+	CHECK(samplog::GetStats(module_id, stats));
+	CHECK(stats.messages_written == 11);
+	unsigned long long samples = 0;
+	for (auto count : stats.buffer_latency_histogram)
+		samples += count;
+	CHECK(samples == 1);
+
+	test::StopLogCore();
+}
+
+TEST_CASE(LogManagerModuleLimit)
+{
+	CHECK(test::StartLogCore({}));
+
+	// "log-core" has one already
+	unsigned int registered = 0, rejected = 0;
+	for (unsigned int i = 0; i != 1100; ++i)
+	{
+		const std::string name = "module-" + std::to_string(i);
+		if (samplog::RegisterModule(name.c_str()) != 0)
+			++registered;
+		else
+			++rejected;
+	}
+	CHECK(registered == 1023);
+	CHECK(rejected == 1100 - 1023);
+	CHECK(!samplog::LogMessage("module-1099", LogLevel::ERROR, "discarded"));
+	// the writer reports it at the latest while it writes this
+	CHECK(samplog::LogMessage("module-0", LogLevel::INFO, "still there"));
+	CHECK(samplog::Flush(10000));
+
+	size_t errors = 0;
+	for (auto const &m : test::ReadLogMessages("logs/log-core.log"))
+	{
+		if (m.find("can't register more than 1024 modules") != std::string::npos)
+			++errors;
+	}
+	CHECK(errors == 1);
+
+	test::StopLogCore();
+}
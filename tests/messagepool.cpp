@@ -0,0 +1,68 @@
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "CMessagePool.hpp"
+#include "CMessage.hpp"
+#include "test.hpp"
+
+
+TEST_CASE(MessagePoolExhaustion)
+{
+	CMessagePool pool(64, 4);
+
+	std::vector<void *> blocks;
+	for (int i = 0; i != 4; ++i)
+	{
+		void *block = pool.Allocate(64);
+		CHECK(block != nullptr && pool.Owns(block));
+		blocks.push_back(block);
+	}
+	CHECK(pool.Allocate(1) == nullptr); // exhausted
+	CHECK(pool.Allocate(1024) == nullptr); // too big anyway
+
+	pool.Free(blocks.back());
+	blocks.pop_back();
+	void *block = pool.Allocate(16);
+	CHECK(block != nullptr && pool.Owns(block));
+	blocks.push_back(block);
+
+	for (void *b : blocks)
+		pool.Free(b);
+}
+
+TEST_CASE(MessageHeapFallback)
+{
+	CMessagePool pool(256, 1);
+	const AmxFuncCallInfo call_info[2] = {
+		{ 12, "script.pwn", "OnGameModeInit" },
+		{ 34, "include.inc", "Func" }
+	};
+
+	Message_t pooled = CMessage::Create(pool, 1, LogLevel::INFO,
+		"pooled", 6, call_info, 2);
+	CHECK(pool.Owns(pooled.get()));
+
+	// the only block is taken, the next message has to go to the heap
+	Message_t heap = CMessage::Create(pool, 2, LogLevel::ERROR, "heap", 4);
+	CHECK(!pool.Owns(heap.get()));
+	CHECK(std::strcmp(heap->GetText(), "heap") == 0);
+	CHECK(heap->log_module == 2 && heap->loglevel == LogLevel::ERROR);
+
+	// as well as a message which is too big for a block
+	const std::string long_text(1000, 'x');
+	Message_t big = CMessage::Create(pool, 1, LogLevel::INFO,
+		long_text.c_str(), long_text.length());
+	CHECK(!pool.Owns(big.get()));
+	CHECK(big->GetTextLength() == long_text.length() && big->GetText() == long_text);
+
+	CHECK(pooled->GetCallInfoCount() == 2);
+	CHECK(pooled->GetCallInfo()[1].line == 34);
+	CHECK(std::strcmp(pooled->GetText(), "pooled") == 0);
+
+	// freeing the pooled message gives its block back
+	pooled.reset();
+	heap.reset();
+	Message_t again = CMessage::Create(pool, 1, LogLevel::INFO, "again", 5);
+	CHECK(pool.Owns(again.get()));
+}
@@ -0,0 +1,65 @@
+#include <thread>
+#include <chrono>
+
+#include "CRateLimiter.hpp"
+#include "test.hpp"
+
+
+namespace
+{
+	CRateLimiter::Limit MakeLimit(unsigned int rate, unsigned int burst)
+	{
+		CRateLimiter::Limit limit;
+		limit.rate = rate;
+		limit.burst = burst;
+		return limit;
+	}
+}
+
+
+TEST_CASE(RateLimiterBurst)
+{
+	CRateLimiter::Limit levels[CRateLimiter::LevelCount];
+	CRateLimiter limiter(MakeLimit(1, 5), levels);
+	CHECK(limiter.GetRate() == 1);
+	CHECK(limiter.GetAvailableTokens() == 5);
+
+	int passed = 0;
+	for (int i = 0; i != 20; ++i)
+		passed += limiter.TryAcquire(LogLevel::INFO) ? 1 : 0;
+	CHECK(passed == 5);
+	CHECK(limiter.GetAvailableTokens() == 0);
+}
+
+TEST_CASE(RateLimiterLevels)
+{
+	CRateLimiter::Limit levels[CRateLimiter::LevelCount];
+	levels[CRateLimiter::GetLevelIndex(LogLevel::DEBUG)] = MakeLimit(1, 2);
+	CRateLimiter limiter(CRateLimiter::Limit(), levels);
+
+	int passed = 0;
+	for (int i = 0; i != 10; ++i)
+		passed += limiter.TryAcquire(LogLevel::DEBUG) ? 1 : 0;
+	CHECK(passed == 2);
+	// other levels and the module aren't limited
+	for (int i = 0; i != 10; ++i)
+		CHECK(limiter.TryAcquire(LogLevel::ERROR));
+	CHECK(limiter.GetAvailableTokens() == 0);
+}
+
+TEST_CASE(RateLimiterRefundsLevelToken)
+{
+	// the module bucket refills every millisecond, the level bucket every 100ms
+	CRateLimiter::Limit levels[CRateLimiter::LevelCount];
+	levels[CRateLimiter::GetLevelIndex(LogLevel::INFO)] = MakeLimit(10, 10);
+	CRateLimiter limiter(MakeLimit(1000, 1), levels);
+
+	int passed = 0;
+	for (int i = 0; i != 100; ++i)
+		passed += limiter.TryAcquire(LogLevel::INFO) ? 1 : 0;
+	CHECK(passed == 1);
+
+	// messages rejected by the module mustn't have used up the level's tokens
+	std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	CHECK(limiter.TryAcquire(LogLevel::INFO));
+}
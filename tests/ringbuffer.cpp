@@ -0,0 +1,122 @@
+#include <thread>
+#include <vector>
+
+#include "CRingBuffer.hpp"
+#include "test.hpp"
+
+
+TEST_CASE(RingBufferPushPop)
+{
+	CRingBuffer<int> queue(5);
+	CHECK(queue.GetCapacity() == 8); // rounded up to a power of two
+	CHECK(queue.IsEmpty());
+
+	int value = -1;
+	CHECK(!queue.TryPop(value));
+
+	for (int i = 0; i != 8; ++i)
+		CHECK(queue.TryPush(int(i)));
+	CHECK(!queue.TryPush(8)); // full
+	CHECK(queue.GetSize() == 8);
+
+	for (int i = 0; i != 8; ++i)
+	{
+		CHECK(queue.TryPop(value));
+		CHECK(value == i);
+	}
+	CHECK(!queue.TryPop(value));
+	CHECK(queue.IsEmpty());
+}
+
+TEST_CASE(RingBufferWrap)
+{
+	CRingBuffer<int> queue(4);
+	int next_push = 0, next_pop = 0;
+	CHECK(queue.TryPush(int(next_push++)));
+	// every lap leaves the positions somewhere else in the slots
+	for (int lap = 0; lap != 10; ++lap)
+	{
+		for (int i = 0; i != 3; ++i)
+			CHECK(queue.TryPush(int(next_push++)));
+		CHECK(!queue.TryPush(-1));
+
+		int value = -1;
+		for (int i = 0; i != 3; ++i)
+		{
+			CHECK(queue.TryPop(value));
+			CHECK(value == next_pop++);
+		}
+	}
+	CHECK(queue.GetSize() == 1);
+	CHECK(queue.GetHeadPosition() == 31);
+	CHECK(queue.GetTailPosition() == 30);
+}
+
+TEST_CASE(RingBufferBatch)
+{
+	CRingBuffer<int> queue(16);
+	for (int i = 0; i != 10; ++i)
+		queue.TryPush(int(i), i * 10);
+
+	std::vector<int> batch;
+	CHECK(queue.TryPopBatch(batch, 4) == 4);
+	CHECK(batch.size() == 4 && batch.front() == 0 && batch.back() == 3);
+
+	int64_t key = 0;
+	CHECK(queue.PeekKey(2, key) && key == 60);
+	CHECK(!queue.PeekKey(6, key));
+
+	batch.clear();
+	CHECK(queue.TryPopBatchWhile(batch, 100, [](int64_t k) { return k < 70; }) == 3);
+	CHECK(batch.size() == 3 && batch.front() == 4 && batch.back() == 6);
+
+	batch.clear();
+	CHECK(queue.TryPopBatch(batch, 100) == 3);
+	CHECK(batch.back() == 9);
+	CHECK(queue.TryPopBatch(batch, 100) == 0);
+}
+
+TEST_CASE(RingBufferConcurrentProducers)
+{
+	const int Producers = 4, PerProducer = 100000;
+	CRingBuffer<int> queue(1024);
+
+	std::vector<std::thread> threads;
+	for (int p = 0; p != Producers; ++p)
+	{
+		threads.emplace_back([&queue, p]()
+		{
+			for (int i = 0; i != PerProducer; ++i)
+			{
+				while (!queue.TryPush(p * PerProducer + i))
+					std::this_thread::yield();
+			}
+		});
+	}
+
+	// the values of every single producer have to come out in order
+	std::vector<int> last(Producers, -1);
+	bool in_order = true;
+	std::vector<int> batch;
+	for (int received = 0; received != Producers * PerProducer; )
+	{
+		batch.clear();
+		if (queue.TryPopBatch(batch, 64) == 0)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+		for (int v : batch)
+		{
+			const int producer = v / PerProducer, index = v % PerProducer;
+			in_order = in_order && index == last[producer] + 1;
+			last[producer] = index;
+		}
+		received += static_cast<int>(batch.size());
+	}
+	for (auto &t : threads)
+		t.join();
+
+	CHECK(in_order);
+	CHECK(queue.IsEmpty());
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vector>
+
+
+/*
+  Minimal test runner without any dependencies: TEST_CASE functions
+  register themselves before main() runs, a failed CHECK reports the
+  expression and marks the running test as failed but lets it go on.
+*/
+namespace test
+{
+	using Func = void(*)();
+
+	struct Case
+	{
+		const char *name;
+		Func func;
+	};
+
+	std::vector<Case> &GetCases();
+	void Fail(const char *file, int line, const char *expr);
+
+	struct Registrar
+	{
+		Registrar(const char *name, Func func)
+		{
+			GetCases().push_back({ name, func });
+		}
+	};
+}
+
+#define TEST_CASE(name) \
+	static void name(); \
+	static test::Registrar name##_registrar(#name, name); \
+	static void name()
+
+#define CHECK(expr) \
+	do { if (!(expr)) test::Fail(__FILE__, __LINE__, #expr); } while (0)
@@ -0,0 +1,471 @@
+/*
+  Measures the logging hot paths of log-core, to compare releases and
+  catch performance regressions.
+
+  usage: log-core-bench [-t <threads>] [-n <messages>] [-s <size>]
+                        [-c "<variable> <value>"]... [-k]
+
+  -t  maximum number of producer threads, every scenario runs with
+      1, 2, 4, ... up to this many threads (default: 4)
+  -n  number of messages logged per producer thread (default: 100000)
+  -s  length of the logged messages in bytes (default: 64)
+  -c  adds a line to the server.cfg used for the run, can be repeated
+      (e.g. -c "logcore_writebackend mmap")
+  -k  keep the temporary directory with the log files
+
+  Every run happens in a fresh temporary directory. Reported are the
+  enqueue latency percentiles of a single log call, the rate at which
+  producers could enqueue messages, the sustained rate including writing
+  everything to disk, the time from the last enqueued message until all
+  log files are synced to disk, and the heap allocations per message
+  (those of the whole process, not counted on Windows).
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <memory>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__)
+#  define WIN32_LEAN_AND_MEAN
+#  include <Windows.h>
+#  include <direct.h>
+#  include <io.h>
+#else
+#  include <unistd.h>
+#  include <fcntl.h>
+#  include <sys/stat.h>
+#endif
+
+#include <tinydir/tinydir.h>
+#include "amx/amx.h"
+#include <samplog/PluginLogger.h>
+
+using samplog::LogLevel;
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	std::atomic<unsigned long long> AllocationCount{ 0 };
+
+	struct Options
+	{
+		unsigned int max_threads = 4;
+		size_t messages = 100000;
+		size_t message_size = 64;
+		std::vector<std::string> config;
+		bool keep_directory = false;
+	};
+
+	struct Result
+	{
+		std::vector<long long> latencies; // in nanoseconds, sorted
+		Clock::duration enqueue_time;
+		Clock::duration total_time;
+		Clock::duration durable_time;
+		unsigned long long allocations;
+	};
+
+	// logs a single message, 'thread' is the index of the producer thread
+	using LogFunction = std::function<void(unsigned int thread)>;
+
+	struct Scenario
+	{
+		const char *name;
+		// returns the log function for a run with 'thread_count' producers,
+		// called after log-core got initialized
+		std::function<LogFunction(unsigned int thread_count)> setup;
+		const char *logfile;
+	};
+
+	// a minimal AMX instance, just enough for log-core to read
+	// native call parameters from it
+	class CFakeAmx
+	{
+	public:
+		CFakeAmx() :
+			m_Memory(sizeof(AMX_HEADER) + DataSize, 0)
+		{
+			AMX_HEADER *header = reinterpret_cast<AMX_HEADER *>(m_Memory.data());
+			header->magic = AMX_MAGIC;
+			header->dat = sizeof(AMX_HEADER);
+
+			std::memset(&m_Amx, 0, sizeof(m_Amx));
+			m_Amx.base = m_Memory.data();
+			m_Amx.hea = m_Amx.stk = m_Amx.stp = DataSize;
+
+			// the string parameter lives at address 0
+			cell *data = reinterpret_cast<cell *>(m_Memory.data() + header->dat);
+			const char str[] = "benchmark string parameter";
+			for (size_t i = 0; i != sizeof(str); ++i)
+				data[i] = str[i];
+
+			float float_param = 1.5f;
+			m_Params[0] = 3 * sizeof(cell);
+			m_Params[1] = 42;
+			m_Params[2] = 0;
+			std::memcpy(&m_Params[3], &float_param, sizeof(cell));
+		}
+
+		AMX *GetAmx()
+		{
+			return &m_Amx;
+		}
+		cell *GetParams()
+		{
+			return m_Params;
+		}
+
+	private:
+		static const cell DataSize = 256 * sizeof(cell);
+
+		std::vector<unsigned char> m_Memory;
+		AMX m_Amx;
+		cell m_Params[4];
+	};
+
+	void PrintUsage()
+	{
+		std::fputs("usage: log-core-bench [-t <threads>] [-n <messages>] [-s <size>] "
+			"[-c \"<variable> <value>\"]... [-k]\n", stderr);
+	}
+
+	bool CreateTempDirectory(std::string &dest)
+	{
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__)
+		char temp_path[MAX_PATH];
+		if (GetTempPathA(sizeof(temp_path), temp_path) == 0)
+			return false;
+		for (unsigned int i = 0; i != 100; ++i)
+		{
+			dest = std::string(temp_path) + "log-core-bench-"
+				+ std::to_string(GetCurrentProcessId()) + "-" + std::to_string(i);
+			if (_mkdir(dest.c_str()) == 0)
+				return true;
+		}
+		return false;
+#else
+		const char *temp_path = std::getenv("TMPDIR");
+		std::string path_template = std::string(temp_path != nullptr ? temp_path : "/tmp")
+			+ "/log-core-bench-XXXXXX";
+		if (mkdtemp(&path_template[0]) == nullptr)
+			return false;
+		dest = path_template;
+		return true;
+#endif
+	}
+
+	bool ChangeDirectory(std::string const &path)
+	{
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__)
+		return _chdir(path.c_str()) == 0;
+#else
+		return chdir(path.c_str()) == 0;
+#endif
+	}
+
+	void RemoveDirectory(std::string const &path)
+	{
+		tinydir_dir dir;
+		if (tinydir_open(&dir, path.c_str()) != 0)
+			return;
+
+		while (dir.has_next)
+		{
+			tinydir_file file;
+			tinydir_readfile(&dir, &file);
+			if (file.is_dir)
+			{
+				if (std::strcmp(file.name, ".") != 0 && std::strcmp(file.name, "..") != 0)
+					RemoveDirectory(file.path);
+			}
+			else
+			{
+				std::remove(file.path);
+			}
+			tinydir_next(&dir);
+		}
+		tinydir_close(&dir);
+
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__)
+		_rmdir(path.c_str());
+#else
+		rmdir(path.c_str());
+#endif
+	}
+
+	// makes sure everything written to 'path' actually is on the disk
+	void SyncFile(const char *path)
+	{
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__)
+		const int fd = _open(path, _O_RDWR);
+		if (fd == -1)
+			return;
+		_commit(fd);
+		_close(fd);
+#else
+		const int fd = open(path, O_RDONLY);
+		if (fd == -1)
+			return;
+		fsync(fd);
+		close(fd);
+#endif
+	}
+
+	Result Run(Scenario const &scenario, unsigned int thread_count, Options const &options)
+	{
+		Result result;
+		std::vector<std::vector<long long>> thread_latencies(thread_count);
+		for (auto &l : thread_latencies)
+			l.resize(options.messages);
+
+		samplog::Init();
+		const LogFunction log = scenario.setup(thread_count);
+
+		std::atomic<unsigned int> ready_threads{ 0 };
+		std::atomic<bool> start{ false };
+		std::vector<std::thread> threads;
+		for (unsigned int t = 0; t != thread_count; ++t)
+		{
+			threads.emplace_back([&, t]()
+			{
+				std::vector<long long> &latencies = thread_latencies[t];
+				++ready_threads;
+				while (!start)
+					std::this_thread::yield();
+
+				for (size_t i = 0; i != options.messages; ++i)
+				{
+					const auto begin = Clock::now();
+					log(t);
+					latencies[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(
+						Clock::now() - begin).count();
+				}
+			});
+		}
+		while (ready_threads != thread_count)
+			std::this_thread::yield();
+
+		const unsigned long long allocations_before = AllocationCount;
+		const auto begin = Clock::now();
+		start = true;
+		for (auto &t : threads)
+			t.join();
+		const auto enqueued = Clock::now();
+
+		// the writer threads finish all pending writes before log-core shuts down
+		samplog::Exit();
+		SyncFile(scenario.logfile);
+		const auto end = Clock::now();
+		result.allocations = AllocationCount - allocations_before;
+
+		result.enqueue_time = enqueued - begin;
+		result.total_time = end - begin;
+		result.durable_time = end - enqueued;
+
+		for (auto &l : thread_latencies)
+			result.latencies.insert(result.latencies.end(), l.begin(), l.end());
+		std::sort(result.latencies.begin(), result.latencies.end());
+
+		// every run starts with an empty log file
+		std::remove(scenario.logfile);
+		return result;
+	}
+
+	long long GetPercentile(std::vector<long long> const &sorted_values, double percentile)
+	{
+		if (sorted_values.empty())
+			return 0;
+		const size_t idx = static_cast<size_t>(percentile / 100.0 * (sorted_values.size() - 1));
+		return sorted_values[idx];
+	}
+
+	double GetRate(size_t count, Clock::duration duration)
+	{
+		const double seconds = std::chrono::duration<double>(duration).count();
+		return seconds > 0.0 ? count / seconds : 0.0;
+	}
+}
+
+
+void *operator new(std::size_t size)
+{
+	++AllocationCount;
+	if (size == 0)
+		size = 1;
+	if (void *ptr = std::malloc(size))
+		return ptr;
+	throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size)
+{
+	return ::operator new(size);
+}
+
+void operator delete(void *ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+	std::free(ptr);
+}
+
+
+int main(int argc, char *argv[])
+{
+	Options options;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+		{
+			options.max_threads = std::max(std::atoi(argv[++i]), 1);
+		}
+		else if (std::strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+		{
+			options.messages = std::max(std::atoi(argv[++i]), 1);
+		}
+		else if (std::strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+		{
+			options.message_size = std::max(std::atoi(argv[++i]), 0);
+		}
+		else if (std::strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+		{
+			options.config.push_back(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "-k") == 0)
+		{
+			options.keep_directory = true;
+		}
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	std::string directory;
+	if (!CreateTempDirectory(directory) || !ChangeDirectory(directory))
+	{
+		std::fputs("can't create a temporary directory\n", stderr);
+		return 1;
+	}
+
+	// log-core reads its configuration from the current directory
+	std::FILE *config_file = std::fopen("server.cfg", "w");
+	if (config_file == nullptr)
+	{
+		std::fputs("can't create server.cfg\n", stderr);
+		return 1;
+	}
+	for (auto const &line : options.config)
+		std::fprintf(config_file, "%s\n", line.c_str());
+	std::fclose(config_file);
+
+	const std::string message(options.message_size, 'x');
+	CFakeAmx fake_amx;
+	// one logger per producer thread, like one per plugin
+	std::vector<std::unique_ptr<samplog::CPluginLogger>> loggers;
+
+	const std::vector<Scenario> scenarios{
+		{
+			"samplog_LogMessage",
+			[&](unsigned int) -> LogFunction
+			{
+				return [&](unsigned int)
+				{
+					samplog_LogMessage("bench", LogLevel::INFO, message.c_str());
+				};
+			},
+			"logs/bench.log"
+		},
+		{
+			"CLogger::Log",
+			[&](unsigned int thread_count) -> LogFunction
+			{
+				loggers.clear();
+				for (unsigned int i = 0; i != thread_count; ++i)
+				{
+					loggers.emplace_back(new samplog::CPluginLogger("bench"));
+					loggers.back()->SetLogLevel(LogLevel::INFO);
+				}
+				return [&](unsigned int thread)
+				{
+					loggers[thread]->Log(LogLevel::INFO, message.c_str());
+				};
+			},
+			"logs/plugins/bench.log"
+		},
+		{
+			"samplog_LogNativeCall",
+			[&](unsigned int) -> LogFunction
+			{
+				return [&](unsigned int)
+				{
+					samplog_LogNativeCall("bench-native", fake_amx.GetAmx(),
+						fake_amx.GetParams(), "BenchNative", "dsf");
+				};
+			},
+			"logs/bench-native.log"
+		},
+	};
+
+	std::printf("%u messages of %u bytes per thread, in \"%s\"\n\n",
+		static_cast<unsigned int>(options.messages),
+		static_cast<unsigned int>(options.message_size), directory.c_str());
+	std::printf("%-22s %7s %9s %9s %9s %13s %13s %11s %10s\n",
+		"scenario", "threads", "p50 ns", "p99 ns", "p999 ns",
+		"enqueue/s", "sustained/s", "durable ms", "allocs/msg");
+
+	for (auto const &scenario : scenarios)
+	{
+		std::vector<unsigned int> thread_counts;
+		for (unsigned int t = 1; t < options.max_threads; t *= 2)
+			thread_counts.push_back(t);
+		thread_counts.push_back(options.max_threads);
+
+		for (unsigned int thread_count : thread_counts)
+		{
+			const Result result = Run(scenario, thread_count, options);
+			const size_t total_messages = thread_count * options.messages;
+
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__)
+			// log-core uses its own heap, its allocations can't be counted
+			const std::string allocations("n/a");
+#else
+			char allocations[32];
+			std::snprintf(allocations, sizeof(allocations), "%.2f",
+				static_cast<double>(result.allocations) / total_messages);
+#endif
+
+			std::printf("%-22s %7u %9lld %9lld %9lld %13.0f %13.0f %11.1f %10s\n",
+				scenario.name, thread_count,
+				GetPercentile(result.latencies, 50.0),
+				GetPercentile(result.latencies, 99.0),
+				GetPercentile(result.latencies, 99.9),
+				GetRate(total_messages, result.enqueue_time),
+				GetRate(total_messages, result.total_time),
+				std::chrono::duration<double, std::milli>(result.durable_time).count(),
+				&allocations[0]);
+		}
+	}
+
+	loggers.clear();
+	if (!options.keep_directory)
+	{
+		ChangeDirectory("..");
+		RemoveDirectory(directory);
+	}
+	return 0;
+}
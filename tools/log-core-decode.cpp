@@ -0,0 +1,172 @@
+/*
+  Renders binary module logs ("logcore_outputformat binary") in the
+  same text format log-core writes otherwise.
+
+  usage: log-core-decode [-t <time format>] [-l <level>] [-p] <file.bin>...
+
+  -t  date/time format, same as the "logtimeformat" server.cfg variable
+  -l  only decode messages of this log level
+  -p  prefix messages with their module name instead of the log level,
+      like warnings.log and errors.log do
+  Records of multiple files are merged by their timestamp.
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <fmt/format.h>
+
+#include "binlog.hpp"
+#include "loglevel.hpp"
+#include "CTimestampFormatter.hpp"
+
+
+namespace
+{
+	struct DecodedRecord
+	{
+		binlog::Record record;
+		const std::string *module_name;
+	};
+
+	bool ReadFile(const char *path, std::string &module_name,
+		std::vector<binlog::Record> &dest)
+	{
+		std::FILE *file = std::fopen(path, "rb");
+		if (file == nullptr)
+		{
+			std::fprintf(stderr, "can't open \"%s\"\n", path);
+			return false;
+		}
+
+		bool success = binlog::ReadFileHeader(file, module_name);
+		if (success)
+		{
+			binlog::Record record;
+			while (binlog::ReadRecord(file, record))
+				dest.push_back(std::move(record));
+
+			// a truncated last record is expected after a crash
+			if (!std::feof(file))
+				std::fprintf(stderr, "\"%s\": corrupt record, stopped decoding\n", path);
+		}
+		else
+		{
+			std::fprintf(stderr, "\"%s\" is not a binary log-core log file\n", path);
+		}
+
+		std::fclose(file);
+		return success;
+	}
+
+	void PrintUsage()
+	{
+		std::fputs("usage: log-core-decode [-t <time format>] [-l <level>] [-p] <file.bin>...\n", stderr);
+	}
+}
+
+
+int main(int argc, char *argv[])
+{
+	std::string time_format("%x %X");
+	bool filter_level = false;
+	LogLevel level_filter = LogLevel::NONE;
+	bool module_prefix = false;
+	std::vector<const char *> files;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+		{
+			time_format = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "-l") == 0 && i + 1 < argc)
+		{
+			if (!ParseLogLevel(argv[++i], level_filter))
+			{
+				PrintUsage();
+				return 1;
+			}
+			filter_level = true;
+		}
+		else if (std::strcmp(argv[i], "-p") == 0)
+		{
+			module_prefix = true;
+		}
+		else if (argv[i][0] == '-')
+		{
+			PrintUsage();
+			return 1;
+		}
+		else
+		{
+			files.push_back(argv[i]);
+		}
+	}
+
+	if (files.empty())
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	//delete brackets, like log-core does
+	size_t pos = 0;
+	while ((pos = time_format.find_first_of("[]()")) != std::string::npos)
+		time_format.erase(pos, 1);
+	CTimestampFormatter timestamp("{:" + time_format + "}");
+
+	std::vector<std::string> module_names(files.size());
+	std::vector<DecodedRecord> records;
+	bool success = true;
+	for (size_t i = 0; i != files.size(); ++i)
+	{
+		std::vector<binlog::Record> file_records;
+		if (!ReadFile(files[i], module_names[i], file_records))
+			success = false;
+
+		for (auto &r : file_records)
+		{
+			if (filter_level && r.level != level_filter)
+				continue;
+			records.push_back(DecodedRecord{ std::move(r), &module_names[i] });
+		}
+	}
+
+	if (files.size() > 1)
+	{
+		std::stable_sort(records.begin(), records.end(),
+			[](DecodedRecord const &lhs, DecodedRecord const &rhs)
+		{
+			return lhs.record.timestamp < rhs.record.timestamp;
+		});
+	}
+
+	for (auto const &r : records)
+	{
+		fmt::MemoryWriter log_string;
+		log_string << r.record.text;
+		if (!r.record.call_info.empty())
+		{
+			log_string << " (";
+			for (size_t i = 0; i != r.record.call_info.size(); ++i)
+			{
+				if (i != 0)
+					log_string << " -> ";
+				log_string << r.record.call_info[i].second << ":" << r.record.call_info[i].first;
+			}
+			log_string << ")";
+		}
+
+		const std::string line = fmt::format("[{}] [{}] {}\n",
+			timestamp.Format(r.record.timestamp),
+			module_prefix ? r.module_name->c_str() : GetLogLevelName(r.record.level),
+			log_string.str());
+		std::fwrite(line.data(), 1, line.length(), stdout);
+	}
+
+	return success ? 0 : 1;
+}